@@ -0,0 +1,304 @@
+///
+///  @file checkpoint.h
+///  @brief the declaration and definition of the RunCheckpoint class
+///
+
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "position.h"
+#include "game.h"
+
+/// @brief RunCheckpoint keeps an append-only journal of a self-play run so
+/// the run can be stopped and resumed exactly where it left off.
+///
+/// The file starts with a header naming the geometry and the rules that
+/// change play (gravity and the engine's radius); a journal is only resumed
+/// under the same ones. Each record after it holds the run's counters, the
+/// game loop's random number state, the -stats tables, and only the winning
+/// positions found since the record before, so a record costs what changed
+/// and not the whole dedup table.
+/// Every record carries its length and a checksum: a resume replays the
+/// records in order and stops at the first one a crash left torn.
+///
+/// The game loop only copies its counters and the new positions into a
+/// record and queues it; a writer thread appends and flushes the records,
+/// so the games never wait on the disk.
+///
+class RunCheckpoint {
+public:
+    typedef std::unordered_map<Position, size_t, Position::Hash> table_t;
+
+    /// @brief the counters of a run
+    struct State {
+        uint64_t            games = 0;
+        uint64_t            count = 0;          // games left to play
+        uint64_t            results[3] {};      // O wins, X wins, draws
+        uint64_t            saved = 0;          // open cells left when a game was drawn early
+        uint64_t            rng = 0;            // the game loop's ThreadRng state
+        double              seconds = 0.0;
+        vector<uint64_t>    stats;              // GameStats::counts(), or empty without -stats
+    };
+
+private:
+    static uint64_t constexpr FileMagic = 0x4e52554c4c455347ull;
+    static uint64_t constexpr RecordMagic = 0x44524f4345524e52ull;
+
+    using clock = std::chrono::steady_clock;
+
+    string                          m_file;
+    uint64_t                        m_header[5];    // magic, geometry, base, gravity, radius
+    int                             m_cells;
+    int                             m_words;        // words in a packed position
+    vector<uint64_t>                m_fresh;        // positions found since the last record, each followed by its index
+    double                          m_interval;
+    clock::time_point               m_next;         // when the next record is due
+
+    FILE                           *m_fp;
+    std::thread                     m_writer;
+    mutable std::mutex              m_lock;         // guards the members below
+    std::condition_variable         m_wake;
+    std::deque<vector<uint64_t>>    m_queue;        // records waiting to be written
+    bool                            m_done;
+    bool                            m_failed;
+    uint64_t                        m_records;
+
+    static uint64_t checksum(uint64_t const *words, size_t const n) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (size_t i=0; i < n; ++i) {
+            h = (h ^ words[i]) * 0x100000001b3ull;
+            h ^= h >> 29;
+        }
+        return h;
+    }
+
+
+    /// @brief append queued records until close() says there will be no more
+    void write_records() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        for (;;) {
+            m_wake.wait(lock, [this] { return m_done || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            vector<uint64_t> const record = std::move(m_queue.front());
+            m_queue.pop_front();
+
+            lock.unlock();
+            bool const ok = fwrite(record.data(), sizeof(uint64_t), record.size(), m_fp) == record.size()
+                         && fflush(m_fp) == 0;
+            lock.lock();
+
+            m_failed = m_failed || !ok;
+            m_records++;
+        }
+    } // RunCheckpoint::write_records()
+
+public:
+    /// @brief journal runs of 'game''s geometry and rules to 'file', a record every 'interval' seconds
+    RunCheckpoint(InARowGame const &game, string const &file, double const interval) :
+        m_file(file),
+        m_header { FileMagic, uint64_t(game.m_grid) | (uint64_t(game.m_dims - 2) << 32), uint64_t(game.m_base),
+                   uint64_t(game.m_gravity), uint64_t(game.m_radius) },
+        m_cells(game.m_cells),
+        m_words(Position(game.m_cells).words()),
+        m_interval(interval),
+        m_next(clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(interval))),
+        m_fp(nullptr),
+        m_done(false),
+        m_failed(false),
+        m_records(0) {
+    } // RunCheckpoint::RunCheckpoint(...)
+
+
+    ~RunCheckpoint() {
+        close();
+    }
+
+
+    RunCheckpoint(RunCheckpoint const &) = delete;
+    RunCheckpoint &operator = (RunCheckpoint const &) = delete;
+
+
+    string const &file() const { return m_file; }
+
+    /// @returns true if there is a file to load() from, whatever it holds
+    bool exists() const { return access(m_file.c_str(), F_OK) == 0; }
+
+    uint64_t records() const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_records;
+    }
+
+
+    /// @name load(State &state, table_t &variations)
+    /// @brief replay the journal into 'state' and 'variations' and cut off
+    /// any torn record at its end so new records follow the last good one
+    /// @returns false if there is no journal for this geometry and these rules
+    bool load(State &state, table_t &variations) {
+        FILE *fp = fopen(m_file.c_str(), "rb");
+        if (fp == nullptr) {
+            return false;
+        }
+
+        uint64_t header[5] {};
+        if (fread(header, sizeof(header), 1, fp) != 1 || memcmp(header, m_header, sizeof(header)) != 0) {
+            fclose(fp);
+            return false;
+        }
+
+        long good = ftell(fp);
+        vector<uint64_t> payload;
+        Position position(m_cells);
+        uint64_t lead[2];
+        while (fread(lead, sizeof(lead), 1, fp) == 1 && lead[0] == RecordMagic && lead[1] < (uint64_t(1) << 32)) {
+            uint64_t sum = 0;
+            payload.resize(size_t(lead[1]));
+            if (fread(payload.data(), sizeof(uint64_t), payload.size(), fp) != payload.size()
+                    || fread(&sum, sizeof(sum), 1, fp) != 1 || sum != checksum(payload.data(), payload.size())) {
+                break;
+            }
+
+            // games, count, results[3], saved, rng, seconds, then the -stats table, then the new positions
+            uint64_t const *p = payload.data();
+            uint64_t const *const end = p + payload.size();
+            if (end - p < 9) {
+                break;
+            }
+            State next;
+            next.games = *p++;
+            next.count = *p++;
+            for (uint64_t &r : next.results) {
+                r = *p++;
+            }
+            next.saved = *p++;
+            next.rng = *p++;
+            memcpy(&next.seconds, p++, sizeof(double));
+            uint64_t const stats = *p++;
+            if (uint64_t(end - p) < stats + 1) {
+                break;
+            }
+            next.stats.assign(p, p + stats);
+            p += stats;
+            uint64_t const found = *p++;
+            if (uint64_t(end - p) != found * uint64_t(m_words + 1)) {
+                break;
+            }
+            for (uint64_t n=0; n < found; ++n, p += m_words + 1) {
+                position.assign(p);
+                variations.emplace(position, size_t(p[m_words]));
+            }
+
+            state = std::move(next);
+            good = ftell(fp);
+        }
+        fclose(fp);
+
+        return truncate(m_file.c_str(), off_t(good)) == 0;
+    } // RunCheckpoint::load(State &state, table_t &variations)
+
+
+    /// @name open(bool const append)
+    /// @brief start the writer: after the records load() kept when 'append',
+    /// else on a new journal
+    /// @returns false if the file can't be written
+    bool open(bool const append) {
+        m_fp = fopen(m_file.c_str(), append ? "ab" : "wb");
+        if (m_fp == nullptr) {
+            return false;
+        }
+        if (!append && (fwrite(m_header, sizeof(m_header), 1, m_fp) != 1 || fflush(m_fp) != 0)) {
+            fclose(m_fp);
+            m_fp = nullptr;
+            return false;
+        }
+        m_writer = std::thread(&RunCheckpoint::write_records, this);
+        return true;
+    } // RunCheckpoint::open(bool const append)
+
+
+    /// @brief note a position added to the dedup table for the next record
+    inline void added(Position const &position, size_t const index) {
+        m_fresh.insert(m_fresh.end(), position.data(), position.data() + m_words);
+        m_fresh.push_back(index);
+    }
+
+
+    /// @returns true once the interval since the last record has passed
+    inline bool due() const {
+        return clock::now() >= m_next;
+    }
+
+
+    /// @name post(State const &state)
+    /// @brief queue a record of 'state' and the positions added since the last one
+    void post(State const &state) {
+        vector<uint64_t> record;
+        record.reserve(13 + state.stats.size() + m_fresh.size());
+        record.push_back(RecordMagic);
+        record.push_back(0);
+        record.push_back(state.games);
+        record.push_back(state.count);
+        record.insert(record.end(), state.results, state.results + 3);
+        record.push_back(state.saved);
+        record.push_back(state.rng);
+        uint64_t seconds;
+        memcpy(&seconds, &state.seconds, sizeof(double));
+        record.push_back(seconds);
+        record.push_back(state.stats.size());
+        record.insert(record.end(), state.stats.begin(), state.stats.end());
+        record.push_back(m_fresh.size() / size_t(m_words + 1));
+        record.insert(record.end(), m_fresh.begin(), m_fresh.end());
+        record[1] = record.size() - 2;
+        record.push_back(checksum(record.data() + 2, record.size() - 2));
+        m_fresh.clear();
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_queue.push_back(std::move(record));
+        }
+        m_wake.notify_one();
+        m_next = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_interval));
+    } // RunCheckpoint::post(State const &state)
+
+
+    /// @name close()
+    /// @brief write every queued record and stop the writer
+    /// @returns false if any record could not be written
+    bool close() {
+        if (m_writer.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_done = true;
+            }
+            m_wake.notify_one();
+            m_writer.join();
+        }
+        if (m_fp != nullptr) {
+            m_failed = (fclose(m_fp) != 0) || m_failed;
+            m_fp = nullptr;
+        }
+        return !m_failed;
+    } // RunCheckpoint::close()
+
+};  // class RunCheckpoint
+
+#endif /* checkpoint_h */
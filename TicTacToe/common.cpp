@@ -5,16 +5,37 @@
 //  Created by trent on 8/7/21.
 //
 
+#include <atomic>
 #include <cstring>
 #include "common.h"
 #include "move.h"
 #include "line.h"
 
 
+//////////////////////////////////////////////////////////
+// Random numbers: each thread seeds its own generator from
+// a shared counter so no two threads draw the same sequence
+static std::atomic<uint64_t> RngSeeds(0x9e3779b97f4a7c15ull);
+
+static uint64_t next_seed() {
+    uint64_t z = RngSeeds.fetch_add(0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+thread_local Rng ThreadRng(next_seed());
+
+void seed_random(uint64_t const seed) {
+    RngSeeds = seed;
+    ThreadRng = Rng(next_seed());
+}
+
+
 string coords(int const num, int const base) {
     string str;
     str += 'A' + num / base;
-    str += itoa(num % base, Grid);
+    str += itoa(num % base, base);
     return str;
 }
 
@@ -139,6 +160,14 @@ string cursOn = CSI + "?25h";
 // Clear the display from cursor to end of the line:
 string clearEOL = CSI + "K";
 
+//////////////////////////////////////////////////////////
+// Clear the display from cursor to the end of the screen:
+string clearEOS = CSI + "J";
+
+//////////////////////////////////////////////////////////
+// Clear the whole display:
+string clearScreen = CSI + "2J";
+
 //////////////////////////////////////////////////////////
 // Position the cursor to a column and row:
 string cursPos(int col, int row) { return string(CSI) + itoa(row) + ";" + itoa(col) + "f"; }
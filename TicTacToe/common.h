@@ -8,6 +8,8 @@
 #ifndef common_h
 #define common_h
 
+#include <cstdint>
+
 #include <string>
 using std::string;
 
@@ -39,6 +41,29 @@ extern void reverse(char s[]);
 extern string commas(int num);
 extern string coords(int const num, int const base);
 
+/// @brief Rng is a small xorshift64* random number generator. Every thread
+/// has its own (ThreadRng) so game threads never share or lock one.
+struct Rng {
+    uint64_t state;
+
+    explicit Rng(uint64_t const seed = 1) : state(seed ? seed : 1) {}
+
+    inline uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dull;
+    }
+
+    /// @returns a number in [0, n)
+    inline uint32_t below(uint32_t const n) {
+        return uint32_t(((next() >> 32) * n) >> 32);
+    }
+};
+
+extern thread_local Rng ThreadRng;
+extern void seed_random(uint64_t const seed);
+
 // ANSI console escape sequences
 extern string CSI;          // ANSI escape sequence prefix
 extern string resetAttr;    // Reset
@@ -51,15 +76,24 @@ extern string strikeAttr;   // Strike-through
 extern string cursOff;      // Turn the cursor Off
 extern string cursOn;       // Turn the cursor On
 extern string clearEOL;     // Clear the display from cursor to end of the line
+extern string clearEOS;     // Clear the display from cursor to end of the screen
+extern string clearScreen;  // Clear the whole display
 extern string cursPos(int col, int row);    // Position the cursor to a column and row:
 
 //////////////////////////////////////
 // Global Variables
 //////////////////////////////////////
 
-extern  int const Grid;
+// the board geometry new games get unless they are given their own
+extern  int       Grid;
 extern  int       Base;
+extern  bool      Gravity;      // pieces drop to the lowest open cell of their column
+extern  int       Dims;         // board dimensions: 2 for a flat board, 3 for a cube, ...
+extern  int       Radius;       // the engine's candidate moves lie within this many cells of a piece (0: anywhere)
 extern  int       DbgLvl;
+extern  bool      Human;
+extern  bool      Legend;
+extern  bool      ShowChoices;
 extern  bool      UseAnsi;
 extern  bool      UseCoords;
 #endif /* common_h */
@@ -0,0 +1,365 @@
+///
+///  @file enumerate.h
+///  @brief the declaration and definition of the Enumerator class
+///
+
+#ifndef enumerate_h
+#define enumerate_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include <iostream>
+using std::cout;
+
+#include <map>
+using std::map;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "position.h"
+#include "threadpool.h"
+
+/// @brief Enumerator walks every legal game of a Grid x Grid / Base
+/// configuration and counts exactly how each one ends.
+///
+/// Every open cell is a legal move, 'X' moves first, and a game ends when
+/// a side gets Base in a row or the board fills up.
+///
+/// The number of games below a position only depends on the position, not
+/// on the moves that led to it, and is the same for all 8 rotations and
+/// reflections of it. So each position is stored in a shared dedup table
+/// under its canonical (smallest) symmetric form, packed 2 bits per cell
+/// into two words, together with the tally of the games below it, and every transposition or symmetric twin of a
+/// position already walked is answered from the table.
+///
+/// The first few plies are expanded breadth first into distinct canonical
+/// positions (with the number of move orders reaching each) and those are
+/// walked in parallel on a WorkStealingPool, each worker doing a depth
+/// first make/unmake walk on its own board.
+///
+class Enumerator {
+public:
+    typedef unsigned __int128 count_t;
+
+    /// @brief the games below a position by how they end
+    struct Tally {
+        count_t games = 0;
+        count_t ends[3] {};     // [0] draws, [1] 'O' wins, [2] 'X' wins
+
+        void add(Tally const &t, count_t const times = 1) {
+            games += t.games * times;
+            for (int i=0; i < 3; ++i) {
+                ends[i] += t.ends[i] * times;
+            }
+        }
+    };
+
+    static int constexpr Shards = 64;
+
+    /// The largest board whose game count is sure to fit in count_t (34! < 2^128)
+    static int constexpr MaxCells = 34;
+
+    /// a position key; every board up to MaxCells fits in its inline words
+    typedef PackedBoard<2> Key;
+
+private:
+    struct Shard {
+        std::mutex                      lock;
+        std::unordered_map<Key, Tally, Key::Hash> table;
+    };
+
+    int const               m_grid;
+    int const               m_base;
+    int const               m_cells;
+    vector<vector<int>>     m_symmetry;     // cell -> cell for each of the 8 board symmetries
+    Shard                   m_shards[Shards];
+    std::atomic<uint64_t>   m_nodes;        // positions visited
+    std::atomic<uint64_t>   m_positions;    // distinct positions (up to symmetry)
+    std::atomic<uint64_t>   m_terminals;    // distinct finished positions (up to symmetry)
+
+
+    /// @name canonical(vector<int8_t> const &board) const
+    /// @returns the smallest key among the 8 symmetric versions of the board
+    Key canonical(vector<int8_t> const &board) const {
+        uint64_t best[2] { ~0ull, ~0ull };
+
+        for (vector<int> const &map : m_symmetry) {
+            uint64_t key[2] {};
+            for (int n=0; n < m_cells; ++n) {
+                int const to = map[n];
+                key[to / Key::CellsPerWord] |= uint64_t(board[n]) << ((to % Key::CellsPerWord) * 2);
+            }
+            if (key[0] < best[0] || (key[0] == best[0] && key[1] < best[1])) {
+                best[0] = key[0];
+                best[1] = key[1];
+            }
+        }
+
+        Key result(m_cells);
+        result.assign(best);
+        return result;
+    } // Enumerator::canonical(vector<int8_t> const &board)
+
+
+    Shard &shard(Key const &key) {
+        return m_shards[key.hash() % Shards];
+    }
+
+
+    /// @name find(Key const &key, Tally &tally)
+    /// @returns true if the position was already walked and 'tally' was set
+    bool find(Key const &key, Tally &tally) {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        auto const found = s.table.find(key);
+        if (found == s.table.end()) {
+            return false;
+        }
+        tally = found->second;
+        return true;
+    } // Enumerator::find(Key const &key, Tally &tally)
+
+
+    /// @name store(Key const &key, Tally const &tally)
+    /// @returns true if this is the first time the position was stored
+    bool store(Key const &key, Tally const &tally) {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.table.emplace(key, tally).second;
+    } // Enumerator::store(Key const &key, Tally const &tally)
+
+
+    /// @name wins(vector<int8_t> const &board, int const cell) const
+    /// @returns true if the piece on 'cell' makes Base in a row
+    bool wins(vector<int8_t> const &board, int const cell) const {
+        static int const dirs[4][2] { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 } };
+        int const piece = board[cell];
+        int const row = cell / m_grid;
+        int const col = cell % m_grid;
+
+        for (auto const &d : dirs) {
+            int run = 1;
+            for (int sign = -1; sign <= 1; sign += 2) {
+                int r = row + d[0] * sign;
+                int c = col + d[1] * sign;
+                while (r >= 0 && r < m_grid && c >= 0 && c < m_grid && board[r * m_grid + c] == piece) {
+                    run++;
+                    r += d[0] * sign;
+                    c += d[1] * sign;
+                }
+            }
+            if (run >= m_base) {
+                return true;
+            }
+        }
+
+        return false;
+    } // Enumerator::wins(vector<int8_t> const &board, int const cell)
+
+
+    /// @name finish(vector<int8_t> const &board, int const winner)
+    /// @brief record a finished position
+    /// @returns the tally of the single game ending here
+    Tally finish(vector<int8_t> const &board, int const winner) {
+        Tally tally;
+        tally.games = 1;
+        tally.ends[winner] = 1;
+        if (store(canonical(board), tally)) {
+            m_terminals++;
+            m_positions++;
+        }
+        return tally;
+    } // Enumerator::finish(vector<int8_t> const &board, int const winner)
+
+
+    /// @name play(vector<int8_t> &board, int const filled, int const cell, Tally &tally)
+    /// @brief make a move, tally the games below it, and unmake it
+    void play(vector<int8_t> &board, int const filled, int const cell, Tally &tally) {
+        int const mover = (filled & 1) ? 1 : 2;
+
+        board[cell] = int8_t(mover);
+        m_nodes++;
+
+        if (wins(board, cell)) {
+            tally.add(finish(board, mover));
+        } else if (filled + 1 == m_cells) {
+            tally.add(finish(board, 0));
+        } else {
+            tally.add(walk(board, filled + 1));
+        }
+
+        board[cell] = 0;
+    } // Enumerator::play(...)
+
+
+    /// @name walk(vector<int8_t> &board, int const filled)
+    /// @brief depth first walk of every game from an unfinished position
+    /// @returns the tally of the games below the position
+    Tally walk(vector<int8_t> &board, int const filled) {
+        Key const key = canonical(board);
+        Tally tally;
+
+        if (find(key, tally)) {
+            return tally;
+        }
+
+        for (int cell=0; cell < m_cells; ++cell) {
+            if (board[cell] == 0) {
+                play(board, filled, cell, tally);
+            }
+        }
+
+        if (store(key, tally)) {
+            m_positions++;
+        }
+
+        return tally;
+    } // Enumerator::walk(vector<int8_t> &board, int const filled)
+
+
+public:
+    Enumerator(int const grid, int const base) :
+        m_grid(grid),
+        m_base(base),
+        m_cells(grid * grid),
+        m_nodes(0),
+        m_positions(0),
+        m_terminals(0) {
+        // the 8 symmetries of the square: 4 rotations, each optionally mirrored
+        for (int t=0; t < 8; ++t) {
+            vector<int> map(m_cells);
+            for (int r=0; r < grid; ++r) {
+                for (int c=0; c < grid; ++c) {
+                    int rr = r, cc = c;
+                    for (int k=0; k < (t & 3); ++k) {
+                        int const tmp = rr;
+                        rr = cc;
+                        cc = grid - 1 - tmp;
+                    }
+                    if (t & 4) {
+                        cc = grid - 1 - cc;
+                    }
+                    map[r * grid + c] = rr * grid + cc;
+                }
+            }
+            m_symmetry.push_back(map);
+        }
+    } // Enumerator::Enumerator(int const grid, int const base)
+
+
+    uint64_t nodes() const { return m_nodes; }
+    uint64_t positions() const { return m_positions; }
+    uint64_t terminals() const { return m_terminals; }
+
+
+    /// @name run(size_t const threads)
+    /// @brief count every game from the empty board
+    /// @returns the tally of all games
+    Tally run(size_t const threads = 0) {
+        struct Start {
+            vector<int8_t>  board;
+            count_t         orders;     // move orders reaching this position
+        };
+
+        Tally total;
+        WorkStealingPool pool(threads);
+
+        // expand the first plies breadth first until there is enough work to share
+        map<Key, Start> level;
+        level[canonical(vector<int8_t>(m_cells, 0))] = { vector<int8_t>(m_cells, 0), 1 };
+        int filled = 0;
+
+        while (!level.empty() && level.size() < pool.size() * 16 && filled < m_cells / 2) {
+            map<Key, Start> next;
+            int const mover = (filled & 1) ? 1 : 2;
+
+            for (auto &entry : level) {
+                Start &start = entry.second;
+                for (int cell=0; cell < m_cells; ++cell) {
+                    if (start.board[cell] != 0) {
+                        continue;
+                    }
+                    start.board[cell] = int8_t(mover);
+                    m_nodes++;
+
+                    Tally single;
+                    if (wins(start.board, cell)) {
+                        single = finish(start.board, mover);
+                        total.add(single, start.orders);
+                    } else if (filled + 1 == m_cells) {
+                        single = finish(start.board, 0);
+                        total.add(single, start.orders);
+                    } else {
+                        Start &child = next[canonical(start.board)];
+                        if (child.board.empty()) {
+                            child.board = start.board;
+                        }
+                        child.orders += start.orders;
+                    }
+
+                    start.board[cell] = 0;
+                }
+            }
+
+            // the expanded positions are walked too; count them as distinct positions
+            m_positions += level.size();
+            level.swap(next);
+            filled++;
+        }
+
+        // walk the remaining positions in parallel
+        vector<Start> starts;
+        for (auto &entry : level) {
+            starts.push_back(entry.second);
+        }
+        vector<Tally> results(starts.size());
+
+        for (size_t i=0; i < starts.size(); ++i) {
+            pool.submit([this, &starts, &results, i, filled] {
+                results[i] = walk(starts[i].board, filled);
+            });
+        }
+        pool.wait();
+
+        for (size_t i=0; i < starts.size(); ++i) {
+            total.add(results[i], starts[i].orders);
+        }
+
+        return total;
+    } // Enumerator::run(size_t const threads)
+
+
+    /// @name to_string(count_t n)
+    /// @returns the count with thousands separators
+    static string to_string(count_t n) {
+        string digits;
+        do {
+            digits += char('0' + int(n % 10));
+            n /= 10;
+        } while (n > 0);
+
+        string result;
+        for (size_t i=0; i < digits.size(); ++i) {
+            if (i > 0 && i % 3 == 0) {
+                result += ',';
+            }
+            result += digits[i];
+        }
+        std::reverse(result.begin(), result.end());
+        return result;
+    } // Enumerator::to_string(count_t n)
+
+};  // class Enumerator
+
+#endif /* enumerate_h */
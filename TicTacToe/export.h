@@ -0,0 +1,479 @@
+///
+///  @file export.h
+///  @brief the declaration and definition of the Exporter and ExportReader classes
+///
+
+#ifndef export_h
+#define export_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "position.h"
+#include "queue.h"
+
+/// @brief ExportRow is one position of a self-play game with the move
+/// chosen from it and how the game ended.
+struct ExportRow {
+    uint64_t    game    = 0;    // game number
+    uint16_t    ply     = 0;    // moves made before this position
+    Position    position;       // the board before the move
+    uint8_t     key     = 0;    // movetype_e of the chosen Move, less NOMOVE
+    int16_t     value   = 0;    // the chosen cell
+    int8_t      outcome = 0;    // 0 draw, 1 'O' won, 2 'X' won
+};
+
+
+/// @brief the columnar export file layout shared by Exporter and ExportReader.
+///
+/// The file starts with a header (magic, grid, base, rows per chunk and
+/// the name and codec of each column) followed by chunks. Every chunk but
+/// the last holds exactly ChunkRows rows and is self contained: a chunk
+/// header (magic, rows, and the codec and byte length of each column) and
+/// then each column's bytes. All integers in the column data are LEB128
+/// varints:
+///
+///     DELTA   (zigzag difference from the previous row, run length) pairs;
+///             the first row's difference is from 0
+///     VARINT  zigzag value
+///     RLE     (zigzag value, run length) pairs
+///     CELLS   per row the number of cells that differ from the previous
+///             row's board (the empty board at ply 0), then for each of
+///             them ((cell - last cell - 1) << 2) | piece
+///
+namespace ExportFormat {
+    static char constexpr FileMagic[8] { 'T', 'T', 'T', 'C', 'O', 'L', 'S', '1' };
+    static uint32_t constexpr ChunkMagic = 0x4b4e4843;     // "CHNK"
+    static uint32_t constexpr ChunkRows = 65536;
+
+    typedef enum : uint8_t { DELTA = 1, VARINT, RLE, CELLS } codec_e;
+
+    struct Column {
+        char const *name;
+        codec_e     codec;
+    };
+
+    static Column constexpr Columns[6] {
+        { "game", DELTA }, { "ply", DELTA }, { "position", CELLS },
+        { "key", VARINT }, { "value", VARINT }, { "outcome", RLE }
+    };
+    static int constexpr NumColumns = 6;
+
+    inline void put(vector<uint8_t> &out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(uint8_t(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(uint8_t(v));
+    }
+
+    inline void put_signed(vector<uint8_t> &out, int64_t const v) {
+        put(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+    }
+
+    /// @returns false if the varint runs past 'end'
+    inline bool get(uint8_t const *&p, uint8_t const *end, uint64_t &v) {
+        v = 0;
+        for (int shift=0; p < end && shift < 64; shift += 7) {
+            uint8_t const b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool get_signed(uint8_t const *&p, uint8_t const *end, int64_t &v) {
+        uint64_t u;
+        if (!get(p, end, u)) return false;
+        v = int64_t(u >> 1) ^ -int64_t(u & 1);
+        return true;
+    }
+
+    /// @name put_runs(vector<uint8_t> &out, vector<int64_t> const &values, bool const delta)
+    /// @brief write RLE pairs of the values, or of their differences for DELTA
+    inline void put_runs(vector<uint8_t> &out, vector<int64_t> const &values, bool const delta) {
+        int64_t last = 0, value = 0;
+        uint64_t run = 0;
+        for (int64_t const v : values) {
+            int64_t const x = delta ? v - last : v;
+            if (run > 0 && x != value) {
+                put_signed(out, value);
+                put(out, run);
+                run = 0;
+            }
+            value = x;
+            run++;
+            last = v;
+        }
+        if (run > 0) {
+            put_signed(out, value);
+            put(out, run);
+        }
+    } // ExportFormat::put_runs(...)
+
+
+    /// @brief reads back a column written by put_runs() one value at a time
+    struct RunReader {
+        uint8_t const  *p;
+        uint8_t const  *end;
+        bool            delta;
+        int64_t         value = 0;
+        int64_t         last = 0;
+        uint64_t        run = 0;
+
+        bool next(int64_t &v) {
+            if (run == 0 && !(get_signed(p, end, value) && get(p, end, run) && run > 0)) {
+                return false;
+            }
+            run--;
+            v = last = delta ? last + value : value;
+            return true;
+        }
+    };
+} // namespace ExportFormat
+
+
+/// @brief Exporter writes self-play rows to a columnar binary file.
+///
+/// Game threads hand over whole games with submit(), which only pushes
+/// onto a lock-free MpscQueue, so they never wait on compression or on
+/// the disk. One writer thread drains the queue, gathers ChunkRows rows,
+/// encodes each column of the chunk with its own codec and writes it.
+///
+class Exporter {
+private:
+    FILE                       *m_fp;
+    int const                   m_grid;
+    int const                   m_base;
+    MpscQueue<vector<ExportRow>> m_queue;
+    vector<ExportRow>           m_rows;         // rows waiting for a full chunk; writer thread only
+    std::thread                 m_writer;
+    std::atomic<bool>           m_closing;
+    std::atomic<uint64_t>       m_written;      // rows written
+    std::atomic<uint64_t>       m_chunks;
+    std::atomic<uint64_t>       m_bytes;
+    bool                        m_ok;
+
+
+    bool write(void const *data, size_t const size) {
+        m_ok = m_ok && fwrite(data, 1, size, m_fp) == size;
+        m_bytes += size;
+        return m_ok;
+    }
+
+
+    /// @name encode(size_t const count, vector<uint8_t> (&cols)[ExportFormat::NumColumns]) const
+    /// @brief encode the first 'count' waiting rows column by column
+    void encode(size_t const count, vector<uint8_t> (&cols)[ExportFormat::NumColumns]) const {
+        using namespace ExportFormat;
+
+        vector<int64_t> games(count), plies(count), outcomes(count);
+        for (size_t i=0; i < count; ++i) {
+            games[i] = int64_t(m_rows[i].game);
+            plies[i] = m_rows[i].ply;
+            outcomes[i] = m_rows[i].outcome;
+            put_signed(cols[3], m_rows[i].key);
+            put_signed(cols[4], m_rows[i].value);
+        }
+        put_runs(cols[0], games, true);
+        put_runs(cols[1], plies, true);
+        put_runs(cols[5], outcomes, false);
+
+        // board: only the cells that changed since the previous row
+        Position const empty(m_grid * m_grid);
+        Position const *prev = &empty;
+        vector<int> changed;
+        for (size_t i=0; i < count; ++i) {
+            Position const &cur = m_rows[i].position;
+            if (m_rows[i].ply == 0) {
+                prev = &empty;
+            }
+            changed.clear();
+            for (int w=0; w < cur.words(); ++w) {
+                for (uint64_t diff = cur.data()[w] ^ prev->data()[w]; diff; ) {
+                    int const bit = __builtin_ctzll(diff);
+                    changed.push_back(w * Position::CellsPerWord + bit / 2);
+                    diff &= ~(uint64_t(3) << (bit & ~1));
+                }
+            }
+            put(cols[2], changed.size());
+            int last = -1;
+            for (int const cell : changed) {
+                put(cols[2], (uint64_t(cell - last - 1) << 2) | uint64_t(cur.get(cell)));
+                last = cell;
+            }
+            prev = &cur;
+        }
+    } // Exporter::encode(...)
+
+
+    /// @name flush(size_t const count)
+    /// @brief write the first 'count' waiting rows as one chunk
+    void flush(size_t const count) {
+        using namespace ExportFormat;
+
+        if (count == 0) {
+            return;
+        }
+
+        vector<uint8_t> cols[NumColumns];
+        encode(count, cols);
+
+        uint32_t const head[2] { ChunkMagic, uint32_t(count) };
+        write(head, sizeof(head));
+        for (int c=0; c < NumColumns; ++c) {
+            uint8_t const codec = Columns[c].codec;
+            uint32_t const size = uint32_t(cols[c].size());
+            write(&codec, 1);
+            write(&size, sizeof(size));
+        }
+        for (int c=0; c < NumColumns; ++c) {
+            write(cols[c].data(), cols[c].size());
+        }
+
+        m_rows.erase(m_rows.begin(), m_rows.begin() + long(count));
+        m_written += count;
+        m_chunks++;
+    } // Exporter::flush(size_t const count)
+
+
+    void run() {
+        using ExportFormat::ChunkRows;
+
+        vector<ExportRow> game;
+        while (true) {
+            bool const closing = m_closing.load();
+            bool idle = true;
+
+            while (m_queue.pop(game)) {
+                idle = false;
+                m_rows.insert(m_rows.end(), std::make_move_iterator(game.begin()), std::make_move_iterator(game.end()));
+                while (m_rows.size() >= ChunkRows) {
+                    flush(ChunkRows);
+                }
+            }
+
+            if (closing && idle) {
+                break;
+            }
+            if (idle) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+
+        flush(m_rows.size());
+    } // Exporter::run()
+
+
+public:
+    Exporter(int const grid, int const base) :
+        m_fp(nullptr),
+        m_grid(grid),
+        m_base(base),
+        m_closing(false),
+        m_written(0),
+        m_chunks(0),
+        m_bytes(0),
+        m_ok(true) {
+    }
+
+    ~Exporter() {
+        close();
+    }
+
+
+    /// @name open(string const &file)
+    /// @brief create the file, write its header and start the writer thread
+    /// @returns true on success
+    bool open(string const &file) {
+        using namespace ExportFormat;
+
+        m_fp = fopen(file.c_str(), "wb");
+        if (m_fp == nullptr) {
+            return false;
+        }
+
+        uint32_t const head[4] { uint32_t(m_grid), uint32_t(m_base), ChunkRows, uint32_t(NumColumns) };
+        write(FileMagic, sizeof(FileMagic));
+        write(head, sizeof(head));
+        for (Column const &c : Columns) {
+            uint8_t const len = uint8_t(strlen(c.name));
+            write(&len, 1);
+            write(c.name, len);
+            write(&c.codec, 1);
+        }
+
+        m_writer = std::thread(&Exporter::run, this);
+        return m_ok;
+    } // Exporter::open(string const &file)
+
+
+    /// @name submit(vector<ExportRow> &&game)
+    /// @brief queue the rows of one game; safe from any thread and never blocks
+    void submit(vector<ExportRow> &&game) {
+        m_queue.push(std::move(game));
+    }
+
+
+    /// @name close()
+    /// @brief write everything submitted so far and close the file
+    /// @returns true if every write succeeded
+    bool close() {
+        if (m_fp == nullptr) {
+            return m_ok;
+        }
+        m_closing = true;
+        if (m_writer.joinable()) {
+            m_writer.join();
+        }
+        m_ok = (fclose(m_fp) == 0) && m_ok;
+        m_fp = nullptr;
+        return m_ok;
+    } // Exporter::close()
+
+
+    uint64_t rows() const { return m_written; }
+    uint64_t chunks() const { return m_chunks; }
+    uint64_t bytes() const { return m_bytes; }
+    size_t backlog() const { return m_queue.size(); }
+
+};  // class Exporter
+
+
+/// @brief ExportReader reads an Exporter file back one chunk at a time.
+class ExportReader {
+private:
+    FILE       *m_fp;
+    int         m_grid;
+    int         m_base;
+
+public:
+    ExportReader() : m_fp(nullptr), m_grid(0), m_base(0) {}
+
+    ~ExportReader() {
+        if (m_fp) fclose(m_fp);
+    }
+
+    int grid() const { return m_grid; }
+    int base() const { return m_base; }
+
+
+    /// @name open(string const &file)
+    /// @returns true if the file has the expected header and columns
+    bool open(string const &file) {
+        using namespace ExportFormat;
+
+        m_fp = fopen(file.c_str(), "rb");
+        if (m_fp == nullptr) {
+            return false;
+        }
+
+        char magic[8];
+        uint32_t head[4];
+        if (fread(magic, sizeof(magic), 1, m_fp) != 1 || memcmp(magic, FileMagic, sizeof(magic)) != 0
+         || fread(head, sizeof(head), 1, m_fp) != 1 || head[3] != uint32_t(NumColumns)) {
+            return false;
+        }
+        m_grid = int(head[0]);
+        m_base = int(head[1]);
+
+        for (Column const &c : Columns) {
+            uint8_t len = 0, codec = 0;
+            char name[256] {};
+            if (fread(&len, 1, 1, m_fp) != 1 || fread(name, 1, len, m_fp) != len
+             || fread(&codec, 1, 1, m_fp) != 1 || strcmp(name, c.name) != 0 || codec != c.codec) {
+                return false;
+            }
+        }
+        return true;
+    } // ExportReader::open(string const &file)
+
+
+    /// @name next(vector<ExportRow> &rows)
+    /// @brief read and decode the next chunk
+    /// @returns false at the end of the file or on a damaged chunk
+    bool next(vector<ExportRow> &rows) {
+        using namespace ExportFormat;
+
+        uint32_t head[2];
+        if (m_fp == nullptr || fread(head, sizeof(head), 1, m_fp) != 1 || head[0] != ChunkMagic) {
+            return false;
+        }
+        size_t const count = head[1];
+
+        uint32_t sizes[NumColumns];
+        for (int c=0; c < NumColumns; ++c) {
+            uint8_t codec;
+            if (fread(&codec, 1, 1, m_fp) != 1 || fread(&sizes[c], sizeof(uint32_t), 1, m_fp) != 1) {
+                return false;
+            }
+        }
+
+        vector<uint8_t> cols[NumColumns];
+        for (int c=0; c < NumColumns; ++c) {
+            cols[c].resize(sizes[c]);
+            if (fread(cols[c].data(), 1, sizes[c], m_fp) != sizes[c]) {
+                return false;
+            }
+        }
+
+        rows.assign(count, ExportRow());
+        uint8_t const *p[NumColumns], *end[NumColumns];
+        for (int c=0; c < NumColumns; ++c) {
+            p[c] = cols[c].data();
+            end[c] = p[c] + cols[c].size();
+        }
+
+        RunReader games { p[0], end[0], true };
+        RunReader plies { p[1], end[1], true };
+        RunReader outcomes { p[5], end[5], false };
+        Position board(m_grid * m_grid);
+
+        for (size_t i=0; i < count; ++i) {
+            int64_t game, ply, outcome, key, value;
+            uint64_t n;
+
+            if (!games.next(game) || !plies.next(ply) || !outcomes.next(outcome)
+             || !get_signed(p[3], end[3], key) || !get_signed(p[4], end[4], value)) {
+                return false;
+            }
+            rows[i].game = uint64_t(game);
+            rows[i].ply = uint16_t(ply);
+            rows[i].outcome = int8_t(outcome);
+            rows[i].key = uint8_t(key);
+            rows[i].value = int16_t(value);
+
+            if (ply == 0) {
+                board.clear();
+            }
+            if (!get(p[2], end[2], n)) return false;
+            int last = -1;
+            for (uint64_t k=0; k < n; ++k) {
+                uint64_t code;
+                if (!get(p[2], end[2], code)) return false;
+                last += int(code >> 2) + 1;
+                if (last >= board.size()) return false;
+                board.set(last, int(code & 3));
+            }
+            rows[i].position = board;
+        }
+
+        return true;
+    } // ExportReader::next(vector<ExportRow> &rows)
+
+};  // class ExportReader
+
+#endif /* export_h */
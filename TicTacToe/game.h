@@ -0,0 +1,777 @@
+///
+///  @file game.h
+///  @brief the declaration and definition of the InARowGame class
+///
+
+#ifndef game_h
+#define game_h
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <map>
+
+#include "common.h"
+#include "move.h"
+#include "line.h"
+#include "linetable.h"
+#include "position.h"
+#include "nnue.h"
+
+using std::stringstream;
+using std::pair;
+using std::cout;
+using std::cin;
+using std::map;
+
+class InARowGame {
+public:
+    static char constexpr m_dispPieces[3] { '.', 'O', 'X' };
+    int           m_grid;       // board width (and height, depth, ...)
+    int           m_base;       // number in a row needed to win
+    bool          m_gravity;    // pieces drop to the lowest open cell of their column
+    int           m_dims;       // number of dimensions: 2 for a flat board, 3 for a cube, ...
+    int           m_cells;      // m_grid ^ m_dims
+    vector<int>   m_board;
+    vector<int>   m_heights;    // pieces in each column (gravity games only)
+    LineTable     m_lines;      // every Line's first cell, delta and code, column by column
+    vector<pair<int, int>> m_cell_lines;    // { line, position } for each Line through each cell, cell by cell
+    vector<int>   m_cell_first; // cell n's entries are m_cell_lines[m_cell_first[n]] up to m_cell_first[n + 1]
+    vector<int>   m_active;     // the Lines that can still be won: none holds pieces of both sides
+    vector<int>   m_slot;       // each Line's index in m_active, or the index it had when it died
+    int           m_radius;     // the engine only moves within this many cells of a piece (0: anywhere)
+    int           m_stones;     // pieces on the board
+    vector<int>   m_near;       // pieces within m_radius of each cell
+    vector<uint64_t> m_candidates;  // a bit per cell: open and within m_radius of a piece
+    int           m_lastmove;
+    uint64_t      m_hash;       // Zobrist hash of the pieces on the board
+    Position      m_position;   // the pieces on the board packed 2 bits per cell
+    NnueAccumulator m_nnue;     // network evaluation kept up to date by place()/unplace() once weights are attached
+    vector<int>   m_windexes;
+    vector<Move> m_history;
+    double        m_tm_total;
+
+public:
+
+
+    /// @name InARowGame(int const grid = Grid, int const base = Base, bool const gravity = Gravity, int const dims = Dims)
+    /// @brief construct a game on a grid x grid board needing base in a row to win.
+    /// Every game carries its own geometry so games of different sizes can run side by side.
+    /// In a gravity game a piece can only go on the lowest open cell of a column.
+    /// With dims above 2 the board is a grid x grid x ... cube (dims 3 and grid 4 is Qubic).
+    /// The engine's candidate radius comes from Radius; gravity games already
+    /// have one cell per column to choose from and ignore it.
+    InARowGame(int const grid = Grid, int const base = Base, bool const gravity = Gravity, int const dims = Dims) :
+        m_grid(grid),
+        m_base(base),
+        m_gravity(gravity),
+        m_dims(dims),
+        m_cells(cells(grid, dims)),
+        m_board(m_cells, 0),
+        m_heights(grid, 0),
+        m_radius(gravity ? 0 : Radius),
+        m_position(m_cells) {
+        assert(dims >= 2 && (dims == 2 || !gravity));
+        init();
+        m_tm_total = 0.0;
+    } // InARowGame::InARowGame(int const grid, int const base, bool const gravity, int const dims)
+
+
+    /// @returns the number of cells on a board 'grid' wide in 'dims' dimensions
+    static int cells(int const grid, int const dims) {
+        int n = 1;
+        for (int d=0; d < dims; ++d) {
+            n *= grid;
+        }
+        return n;
+    } // InARowGame::cells(int const grid, int const dims)
+
+    
+    void init() {
+        init_board();
+        init_lines();
+    } // InARowGame::init()
+
+    // perform a sanity check on a board index
+    void validate_index(const int index, string const &errmsg="", const int stop=0) {
+        if (index < 0 || index >= m_cells) {
+            cout << "invalid board index: " << index << " " << errmsg;
+            if (stop) assert(false);
+        }
+    }
+
+
+    // perform a sanity check on a line
+    void validate_line(Line const &line, string const &errmsg="", const int stop=0) {
+        // validate the member values
+        validate_index(line.m_offset, "m_offset", 1);
+
+        for (int i=0; i < m_base; ++i) {
+            int index = line.m_offset + line.m_delta * i;
+            stringstream ss;
+            ss << "line cell member " << i << " ";
+            validate_index(index, ss.str(), 1);
+        }
+    };
+
+    /// @name init_lines()
+    /// @brief build every Line of the board and the index of Lines through each cell.
+    ///
+    /// A direction is a step of -1, 0 or +1 along each axis, counted once: the
+    /// last nonzero step is +1, so there are (3^dims - 1) / 2 of them (the
+    /// four of a flat board, 13 in a cube). Axis 0 runs along a row, axis 1
+    /// down the rows, and so on, and a Line is its first cell and the flat
+    /// index delta of its direction. Lines are made for every cell they can
+    /// start on without leaving the board.
+    void init_lines() {
+        assert(m_grid >= m_base);
+
+        vector<int> offsets;
+        vector<int> deltas;
+
+        debug(2, cout << "Generated Lines:\n");
+
+        int const directions = cells(3, m_dims);
+        vector<int> step(m_dims);
+        vector<int> coord(m_dims);
+
+        for (int dir=0; dir < directions; ++dir) {
+            int delta = 0;
+            int last = 0;
+            for (int d=0, code=dir, stride=1; d < m_dims; ++d, code /= 3, stride *= m_grid) {
+                step[d] = code % 3 - 1;
+                delta += step[d] * stride;
+                last = step[d] ? step[d] : last;
+            }
+            if (last != 1) {
+                continue;
+            }
+
+            for (int offset=0; offset < m_cells; ++offset) {
+                bool fits = true;
+                for (int d=0, rest=offset; d < m_dims; ++d, rest /= m_grid) {
+                    int const end = rest % m_grid + step[d] * (m_base - 1);
+                    fits = fits && end >= 0 && end < m_grid;
+                }
+                if (!fits) {
+                    continue;
+                }
+                debug(3, cout << ".");
+                stringstream ss;
+                ss << "Check Line: " << offset << " ";
+                validate_line(Line(offset, delta, m_base, m_grid), ss.str(), 1);
+                offsets.push_back(offset);
+                deltas.push_back(delta);
+            }
+        }
+        debug(3, cout << "\n");
+
+        m_lines.assign(m_base, m_grid, offsets, deltas);
+
+        // index the Lines passing through each cell so placing a piece
+        // only touches the Lines it belongs to. The entries of all cells
+        // share one array so a move reads a single contiguous run.
+        m_cell_first.assign(m_cells + 1, 0);
+        for (int n=0; n < m_lines.size(); ++n) {
+            for (int i=0; i < m_base; ++i) {
+                m_cell_first[m_lines[n].cell(i) + 1]++;
+            }
+        }
+        for (int n=0; n < m_cells; ++n) {
+            m_cell_first[n + 1] += m_cell_first[n];
+        }
+        m_cell_lines.resize(m_cell_first[m_cells]);
+        vector<int> next(m_cell_first.begin(), m_cell_first.end() - 1);
+        for (int n=0; n < m_lines.size(); ++n) {
+            for (int i=0; i < m_base; ++i) {
+                m_cell_lines[next[m_lines[n].cell(i)]++] = { n, i };
+            }
+        }
+
+        reset_active();
+
+        for (int n=0; n < m_lines.size(); ++n) {
+            debug(2, cout << itoa(n, 10, 3) << " " << m_lines[n].to_string() << "\n");
+        }
+        debug(2, cout << "\n");
+        
+    } // InARowGame::init_lines()
+
+    
+    void init_board() {
+        for (int n=0; n < m_cells; ++n) {
+            m_board[n] = 0;
+        }
+        m_heights.assign(m_grid, 0);
+        m_stones = 0;
+        m_near.assign(m_radius > 0 ? m_cells : 0, 0);
+        m_candidates.assign(m_radius > 0 ? (m_cells + 63) / 64 : 0, 0);
+        m_lines.clear();
+        reset_active();
+        m_windexes.clear();
+        m_lastmove = -1;
+        m_hash = 0;
+        m_position.clear();
+        m_history.clear();
+        if (m_nnue.active()) {
+            m_nnue.refresh(*this);
+        }
+    } // InARowGame::init_board()
+
+
+    /// @name reset_active()
+    /// @brief every Line of an empty board can still be won
+    void reset_active() {
+        m_active.resize(m_lines.size());
+        m_slot.resize(m_lines.size());
+        for (int n=0; n < int(m_lines.size()); ++n) {
+            m_active[n] = m_slot[n] = n;
+        }
+    } // InARowGame::reset_active()
+
+
+    void show_lines() {
+        for (int n=0; n < m_lines.size(); ++n) {
+            Line const line = m_lines[n];
+            init_board();
+            for (int i=0; i < m_base; ++i) {
+                m_board[line.m_offset + line.m_delta * i] = 2;
+            }
+            debug(1, cout << "Line " << n + 1 << ":\n");
+            display();
+            debug(1, cout << "\n");
+        }
+    }
+
+
+    /// @name display(bool showLegend=Legend)
+    /// @brief print the board, built in one string and written at once
+    void display(bool showLegend=Legend) {
+        if (DbgLvl < 1) {
+            return;
+        }
+
+        string legend;
+        string out;
+        int const layer = m_grid * m_grid;
+
+        if (showLegend) {
+            legend = "  ";
+            for (int index=0; index < m_grid; ++index) {
+                legend += itoa(index, 26, 2);
+            }
+            legend += "\n";
+        }
+
+        for (int index=0; index < m_cells; ++index) {
+            if (index % layer == 0) {
+                if (m_dims > 2) {
+                    // one grid x grid slice at a time, named by its place along the other axes
+                    string name;
+                    for (int d=2, rest=index / layer; d < m_dims; ++d, rest /= m_grid) {
+                        name += " " + itoa(rest % m_grid);
+                    }
+                    out += (index ? "\n" : "") + string("layer") + name + ":\n";
+                }
+                out += legend;
+            }
+
+            bool highlight = index == m_lastmove;
+            for (const int & w : m_windexes) {
+                if (w == index) {
+                    highlight = true;
+                    break;
+                }
+            }
+
+            string label;
+            if ((index % m_grid == 0) && showLegend) {
+                label = " ";
+                label += 'A' + (index / m_grid) % m_grid;
+                label += " ";
+            }
+
+            out += label;
+            out += (UseAnsi && highlight ? boldAttr : "");
+            out += m_dispPieces[m_board[index]];
+            out += (UseAnsi && highlight ? resetAttr : "");
+            out += (index % m_grid < (m_grid-1) ? " " : "\n");
+        }
+
+        cout << out;
+    } // InARowGame::display()
+
+
+    Move human_move() const {
+        while (true) {
+            cout << "Enter the square to move to (0-" << m_cells - 1 << "): ";
+            cout.flush();
+            int n = -1;
+            if (Legend && m_dims == 2) {
+                string in;
+                cin >> in;
+                if (in.length() == 2) {
+                    char c1 = tolower(in[0]);
+                    char c2 = tolower(in[1]);
+                    c1 -= 'a';
+                    if (c2 >= 'a') {
+                        c2 -= 'a';
+                    } else {
+                        c2 -= '0';
+                    }
+                    n = c1 * m_grid + c2;
+                }
+            } else {
+                cin >> n;
+            }
+
+            if (n < 0 || n >= m_cells || !playable(n)) {
+                cout << "invalid square.\n";
+            } else {
+                return Move(FORCED, n);
+            }
+        }
+    } // InARowGame::human_move()
+
+
+    /**
+     * @summary: Score the Lines that can still be won (m_active).
+     *           A Line holding both sides' pieces can't win or need
+     *           blocking, so it isn't looked at; once none are left the
+     *           game is a draw however many cells are open.
+     *
+     * @returns: { WINNER, {1 or 2} } = line contains 'Base' pieces in a row; Win.
+     *           { NOMOVE, 0 }        = no Line can still be won; Draw.
+     *           { FORCED, pos }      = must move at cell 'pos' to block or win.
+     *           { RANDOM1 or RANDOM2, pos } = open cell 'pos' picked from
+     *                                  the cells shared by the most lines.
+     *
+     *           Each Line is classified by looking its code up in the
+     *           pattern table (see pattern.h).
+     *
+     *           Nothing is displayed so this is safe to call on copies
+     *           of the game from other threads.
+     */
+    inline Move score() {
+        map<movetype_e, Move> moves;
+        vector<int> counts[2] { vector<int>(m_cells, 0), vector<int>(m_cells, 0) };   // Lines through each cell: [0] RANDOM2, [1] RANDOM1
+        Move score;
+
+        if (m_active.empty()) {
+            // every Line holds both sides' pieces: draw without playing out the open cells
+            return Move(NOMOVE, 0);
+        }
+
+        for (int const n : m_active) {
+            Line const line = m_lines[n];
+            Pattern const p = line.pattern();
+            movetype_e const key = p.resolve(m_grid, m_base);
+            if (key == RANDOM1 || key == RANDOM2) {
+                // most Lines: count their open cells without building a Move
+                line.for_open(p, [&](int const c) {
+                    if (playable(c) && candidate(c)) {
+                        moves[key].key = key;
+                        counts[key - RANDOM2][c]++;
+                    }
+                });
+                continue;
+            }
+
+            Move s = line.evaluate();
+            if (s.key == FORCED && !playable(s.value)) {
+                // a gravity game's threat that can't be played yet
+            } else if (s.key == WINNER) {
+                moves[s.key] = s;
+                m_windexes = s.choices;
+            } else {
+                moves[s.key] = s;
+            }
+        }
+
+        if (moves.empty()) {
+            // in a gravity game the Lines still open can't be reached yet,
+            // or they all lie beyond the candidate radius; any open cell will do
+            for (int n=0; n < m_cells; ++n) {
+                if (playable(n)) {
+                    moves[RANDOM2].key = RANDOM2;
+                    counts[0][n]++;
+                }
+            }
+        }
+
+        if (moves.empty()) {
+            moves[NOMOVE] = Move(NOMOVE, 0);
+        }
+
+        // Maps are sorted by their keys.
+        // We take the first one since key (movetype_e) values
+        // are defined in order of their precedence
+        // thus the highest precedence score is first
+
+        score = (*(moves.rbegin())).second;
+        score.key = (*(moves.rbegin())).first;
+        size_t movetypes = moves.size();
+        size_t cp = movetypes;
+        cp = cp ? cp : 0;
+
+        if (score.key == RANDOM1 || score.key == RANDOM2) {
+            vector<int> const &count = counts[score.key - RANDOM2];
+            vector<int> choices;
+            int highest_count = 0;
+            for_candidates([&](int const c) { highest_count = std::max(highest_count, count[c]); });
+            for_candidates([&](int const c) {
+                if (count[c] == highest_count)
+                    choices.push_back(c);
+            });
+            score.choices = choices;
+        }
+
+        switch (score.key) {
+            case WINNER:
+            case NOMOVE:
+            case FORCED:
+                return score;
+
+            case RANDOM1:
+                score.value = score.choices[ThreadRng.below(uint32_t(score.choices.size()))];
+                return score;
+
+            case RANDOM2:
+                score.value = score.choices[ThreadRng.below(uint32_t(score.choices.size()))];
+                return score;
+
+            case ZERO:
+            default:
+                display();
+                cout << "invalid Move (move stance): " << score.to_string(1, m_grid) << "\n";
+                if (score.key == ZERO)
+                    cout << "Move stance is ZERO - must choose at least one available move from all Lines.\n";
+                assert(false);
+                break;
+        }
+
+        assert(false);
+        return score;
+    } // InARowGame::score()
+
+
+    /**
+     * @summary: Score the position and report a finished game.
+     *
+     * @returns: the same Move as score()
+     */
+    inline Move analyze() {
+        Move const result = score();
+
+        switch (result.key) {
+            case WINNER:
+                debug(1, cout << "\n");
+                display();
+                debug(1, cout << "\n" << m_dispPieces[result.value] << " Wins!\n");
+                break;
+
+            case NOMOVE:
+                debug(1, cout << "\n");
+                display();
+                debug(1, cout << "\nDraw!" << (std::count(m_board.begin(), m_board.end(), 0) ? " (no line can be won)" : "") << "\n");
+                break;
+
+            default:
+                break;
+        }
+
+        return result;
+    } // InARowGame::analyze()
+
+
+    /// @name drop(int const column) const
+    /// @returns the cell a piece dropped in 'column' lands on, or -1 if it is full
+    inline int drop(int const column) const {
+        int const height = m_heights[column];
+        return (height < m_grid) ? (m_grid - 1 - height) * m_grid + column : -1;
+    } // InARowGame::drop(int const column)
+
+
+    /// @name playable(int const index) const
+    /// @returns true if a piece can go on the cell now: it is open and, in a
+    /// gravity game, the lowest open cell of its column
+    inline bool playable(int const index) const {
+        return m_board[index] == 0 && (!m_gravity || drop(index % m_grid) == index);
+    } // InARowGame::playable(int const index)
+
+
+    /// @brief the { line, position } entries of one cell: a slice of m_cell_lines
+    struct CellLines {
+        pair<int, int> const *m_first;
+        pair<int, int> const *m_last;
+        pair<int, int> const *begin() const { return m_first; }
+        pair<int, int> const *end() const { return m_last; }
+    };
+
+    inline CellLines cell_lines(int const index) const {
+        pair<int, int> const *base = m_cell_lines.data();
+        return CellLines { base + m_cell_first[index], base + m_cell_first[index + 1] };
+    }
+
+
+    /// @name candidate(int const index) const
+    /// @returns true if the engine considers moving on the cell: it is within
+    /// m_radius cells of a piece along every axis, or there is no radius or no
+    /// piece yet. FORCED cells are played wherever they are.
+    inline bool candidate(int const index) const {
+        return m_radius == 0 || m_stones == 0 || ((m_candidates[index >> 6] >> (index & 63)) & 1);
+    } // InARowGame::candidate(int const index)
+
+
+    /// @name for_candidates(F const &f) const
+    /// @brief call f(index) for every cell candidate() allows, in board order.
+    /// With a radius only the set bits are visited.
+    template<typename F>
+    inline void for_candidates(F const &f) const {
+        if (m_radius == 0 || m_stones == 0) {
+            for (int n=0; n < m_cells; ++n) {
+                f(n);
+            }
+            return;
+        }
+        for (int w=0; w < int(m_candidates.size()); ++w) {
+            for (uint64_t bits = m_candidates[w]; bits != 0; bits &= bits - 1) {
+                f(w * 64 + __builtin_ctzll(bits));
+            }
+        }
+    } // InARowGame::for_candidates(F const &f)
+
+
+    /// @name for_near(int const index, F const &f, int const axis = 0, int const stride = 1) const
+    /// @brief call f(cell) for every cell within m_radius of 'index' along
+    /// every axis from 'axis' up, 'index' included
+    template<typename F>
+    inline void for_near(int const index, F const &f, int const axis = 0, int const stride = 1) const {
+        if (axis == m_dims) {
+            f(index);
+            return;
+        }
+        int const at = (index / stride) % m_grid;
+        int const last = std::min(m_grid - 1, at + m_radius);
+        for (int v=std::max(0, at - m_radius); v <= last; ++v) {
+            for_near(index + (v - at) * stride, f, axis + 1, stride * m_grid);
+        }
+    } // InARowGame::for_near(...)
+
+
+    /// @name mark_near(int const index)
+    /// @brief count a piece on 'index' for the cells around it, making the open ones candidates
+    inline void mark_near(int const index) {
+        for_near(index, [&](int const c) {
+            if (m_near[c]++ == 0 && m_board[c] == 0) {
+                m_candidates[c >> 6] |= uint64_t(1) << (c & 63);
+            }
+        });
+    } // InARowGame::mark_near(int const index)
+
+
+    /// @name set_radius(int const radius)
+    /// @brief consider only the cells within 'radius' of a piece from now
+    /// on (0: every cell) and rebuild the candidates for the pieces on the
+    /// board. Gravity games keep every cell.
+    void set_radius(int const radius) {
+        int const r = m_gravity ? 0 : radius;
+        if (r == m_radius) {
+            return;
+        }
+        m_radius = r;
+        m_near.assign(m_radius > 0 ? m_cells : 0, 0);
+        m_candidates.assign(m_radius > 0 ? (m_cells + 63) / 64 : 0, 0);
+        for (int n=0; m_radius > 0 && n < m_cells; ++n) {
+            if (m_board[n] != 0) {
+                mark_near(n);
+            }
+        }
+    } // InARowGame::set_radius(int const radius)
+
+
+    /// @name place(int const index, int const player)
+    /// @brief put a piece on the board and update the encoding of every Line through it
+    inline void place(int const index, int const player) {
+        assert(playable(index));
+        if (m_nnue.active()) {
+            m_nnue.leave(*this, index);
+        }
+        m_heights[index % m_grid]++;
+        m_board[index] = player;
+        m_hash ^= zobrist(index, player);
+        m_position.toggle(index, player);
+        m_stones++;
+        if (m_radius > 0) {
+            // the cells around the piece become candidates and its own cell stops being one
+            mark_near(index);
+            m_candidates[index >> 6] &= ~(uint64_t(1) << (index & 63));
+        }
+        for (pair<int, int> const &entry : cell_lines(index)) {
+            if (m_lines.pattern(entry.first).owner == 3 - player) {
+                // the other side's Line: it now holds both and can never be won.
+                // Swap the last live Line into its slot; the slot stays in m_slot for unplace().
+                int const slot = m_slot[entry.first];
+                m_active[slot] = m_active.back();
+                m_slot[m_active[slot]] = slot;
+                m_active.pop_back();
+            }
+            m_lines.place(entry.first, entry.second, player);
+        }
+        if (m_nnue.active()) {
+            m_nnue.enter(*this, index);
+        }
+    } // InARowGame::place(int const index, int const player)
+
+
+    /// @name unplace(int const index)
+    /// @brief take a piece back off the board; the exact reverse of place()
+    inline void unplace(int const index) {
+        if (m_nnue.active()) {
+            m_nnue.leave(*this, index);
+        }
+        int const player = m_board[index];
+        m_heights[index % m_grid]--;
+        m_board[index] = 0;
+        m_hash ^= zobrist(index, player);
+        m_position.toggle(index, player);
+        m_stones--;
+        if (m_radius > 0) {
+            for_near(index, [&](int const c) {
+                if (--m_near[c] == 0) {
+                    m_candidates[c >> 6] &= ~(uint64_t(1) << (c & 63));
+                }
+            });
+            if (m_near[index] > 0) {
+                m_candidates[index >> 6] |= uint64_t(1) << (index & 63);
+            }
+        }
+        CellLines const entries = cell_lines(index);
+        for (pair<int, int> const *entry = entries.end(); entry-- != entries.begin(); ) {
+            m_lines.unplace(entry->first, entry->second, player);
+            if (m_lines.pattern(entry->first).owner == 3 - player) {
+                // live again: undo place()'s swap, in the reverse order place() made them.
+                // A Line that was last when it died was only popped, so it just goes back on the end.
+                int const slot = m_slot[entry->first];
+                if (slot == int(m_active.size())) {
+                    m_slot[entry->first] = slot;
+                    m_active.push_back(entry->first);
+                } else {
+                    m_active.push_back(m_active[slot]);
+                    m_slot[m_active.back()] = int(m_active.size()) - 1;
+                    m_active[slot] = entry->first;
+                }
+            }
+        }
+        if (m_nnue.active()) {
+            m_nnue.enter(*this, index);
+        }
+    } // InARowGame::unplace(int const index)
+
+
+    /// @name zobrist(int const index, int const player)
+    /// @returns the hash key for a player's piece on a cell. The keys are
+    /// derived from the cell and piece alone so every game agrees on them.
+    static inline uint64_t zobrist(int const index, int const player) {
+        uint64_t z = uint64_t(index * 2 + player) * 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    } // InARowGame::zobrist(int const index, int const player)
+
+
+    Move make_move(Move const &result, const int turn, bool flag=true) {
+        const int player = ((turn == 0) ? 1 : 2);
+
+        switch (result.key) {
+            case ZERO:
+                assert(false);
+
+            case NOMOVE:    // no open spots are available?
+                return result;
+                
+            case WINNER:    // game has been won
+                assert(m_windexes.size() == m_base);
+                return result;
+
+            case FORCED:    // must move to spot to either block or win?
+                m_history.push_back(result);
+                m_lastmove = result.value;
+                place(m_lastmove, player);
+                debug(1, cout << "making move: " << result.to_string(flag, m_grid) << "\n");
+                return result;
+
+            case RANDOM1:
+                m_history.push_back(result);
+                m_lastmove = result.value;
+                place(m_lastmove, player);
+                debug(1, cout << "making move: " << result.to_string(flag, m_grid) << "\n");
+                return result;
+
+            case RANDOM2:
+                m_history.push_back(result);
+                m_lastmove = result.value;
+                place(m_lastmove, player);
+                debug(1, cout << "making move: " << result.to_string(flag, m_grid) << "\n");
+                return result;
+        }
+
+        assert(false);
+    } // InARowGame::make_move(Move const &result, int turn)
+
+
+    /// @name unmake_move()
+    /// @brief take back the last move made with make_move()
+    ///
+    /// Only the Lines through the cell are touched so this costs the same
+    /// however big the board is. Every Line's code (and so its pattern) is
+    /// exactly what it was before the move. Moves are only made in unfinished
+    /// games so there are never winning indexes to restore.
+    void unmake_move() {
+        assert(!m_history.empty());
+
+        unplace(m_history.back().value);
+        m_history.pop_back();
+        m_lastmove = m_history.empty() ? -1 : m_history.back().value;
+        m_windexes.clear();
+    } // InARowGame::unmake_move()
+
+
+    /// @name think()
+    /// @brief choose the engine's move for the side to move without displaying anything
+    /// @returns the Move the engine wants to make
+    inline Move think() {
+        return score();
+    } // InARowGame::think()
+
+
+    inline Move process(const int turn) {
+        // get the next move
+        Move result = (Human && turn) ? human_move() : think();
+
+        return process(turn, result);
+    } // InARowGame::process(const int turn)
+
+
+    /// @name process(const int turn, Move const &result)
+    /// @brief make an already chosen move and analyze the resulting position
+    inline Move process(const int turn, Move const &result) {
+        // process the move
+        assert(result.key != ZERO);
+        make_move(result, turn, ShowChoices);
+
+        return analyze();
+    } // InARowGame::process(const int turn, Move const &result)
+
+
+    /// @name state() const
+    /// @returns the position, kept packed 2 bits per cell by place() and unplace()
+    Position const &state() const {
+        return m_position;
+    } // InARowGame::state()
+
+};  // class InARowGame
+
+#endif /* game_h */
@@ -0,0 +1,137 @@
+///
+///  @file gravity.h
+///  @brief the declaration and definition of the GravityBoard class
+///
+
+#ifndef gravity_h
+#define gravity_h
+
+#include <cassert>
+#include <cstdint>
+
+#include <vector>
+using std::vector;
+
+/// @brief GravityBoard is a bitboard for the gravity (Connect-Four) rules,
+/// where a piece dropped in a column falls to its lowest open cell.
+///
+/// Column c uses bits c * (rows + 1) up to c * (rows + 1) + rows - 1, the
+/// bottom row first, with one spare bit on top so shifting a column never
+/// runs into the next one. Each side has its own bitboard and each column
+/// its height, so a move is one OR and the legal moves are the columns that
+/// aren't full. A win is found with one shift-and chain per direction:
+///
+///     vertical 1, horizontal rows + 1, diagonals rows and rows + 2
+///
+/// The whole board has to fit in 64 bits: cols * (rows + 1) <= 64, which
+/// covers 7x7 and the 7 wide by 6 high Connect-Four board.
+///
+class GravityBoard {
+private:
+    int const       m_cols;
+    int const       m_rows;
+    int const       m_base;
+    uint64_t        m_pieces[3];        // [1] 'O', [2] 'X'; [0] unused
+    vector<int>     m_heights;          // pieces in each column
+    int             m_moves;
+    uint64_t        m_nodes;            // positions made by perft()
+
+
+    /// @name lines(uint64_t const b, int const shift) const
+    /// @returns the cells that start base pieces in a row in one direction
+    inline uint64_t lines(uint64_t const b, int const shift) const {
+        uint64_t x = b;
+        for (int i=1; i < m_base && x; ++i) {
+            x &= b >> (i * shift);
+        }
+        return x;
+    } // GravityBoard::lines(uint64_t const b, int const shift)
+
+
+public:
+    GravityBoard(int const cols, int const rows, int const base) :
+        m_cols(cols),
+        m_rows(rows),
+        m_base(base),
+        m_pieces {},
+        m_heights(cols, 0),
+        m_moves(0),
+        m_nodes(0) {
+        assert(cols * (rows + 1) <= 64);
+    } // GravityBoard::GravityBoard(int const cols, int const rows, int const base)
+
+
+    /// @returns true if a board of this size fits the 64 bit layout
+    static bool fits(int const cols, int const rows) {
+        return cols > 0 && rows > 0 && cols * (rows + 1) <= 64;
+    }
+
+    int cols() const { return m_cols; }
+    int rows() const { return m_rows; }
+    int moves() const { return m_moves; }
+    uint64_t nodes() const { return m_nodes; }
+
+    inline bool playable(int const col) const { return m_heights[col] < m_rows; }
+
+    /// @returns the InARowGame board index (row 0 at the top) a piece dropped in 'col' lands on
+    inline int cell(int const col) const { return (m_rows - 1 - m_heights[col]) * m_cols + col; }
+
+
+    /// @name play(int const col, int const piece)
+    /// @brief drop 'piece' (1 or 2) into a column that isn't full
+    inline void play(int const col, int const piece) {
+        m_pieces[piece] |= uint64_t(1) << (col * (m_rows + 1) + m_heights[col]);
+        m_heights[col]++;
+        m_moves++;
+    } // GravityBoard::play(int const col, int const piece)
+
+
+    /// @name undo(int const col, int const piece)
+    /// @brief take back the top piece of a column; the reverse of play()
+    inline void undo(int const col, int const piece) {
+        m_heights[col]--;
+        m_moves--;
+        m_pieces[piece] ^= uint64_t(1) << (col * (m_rows + 1) + m_heights[col]);
+    } // GravityBoard::undo(int const col, int const piece)
+
+
+    /// @name won(int const piece) const
+    /// @returns true if 'piece' has base in a row
+    inline bool won(int const piece) const {
+        uint64_t const b = m_pieces[piece];
+        return lines(b, 1) || lines(b, m_rows + 1) || lines(b, m_rows) || lines(b, m_rows + 2);
+    } // GravityBoard::won(int const piece)
+
+
+    /// @name perft(int const depth)
+    /// @brief count the move sequences of 'depth' plies from here; a game
+    /// that is won or full before then ends there and is not counted
+    /// @returns the number of positions 'depth' plies deep
+    uint64_t perft(int const depth) {
+        if (depth == 0) {
+            return 1;
+        }
+
+        int const piece = (m_moves & 1) ? 1 : 2;
+        uint64_t count = 0;
+
+        for (int col=0; col < m_cols; ++col) {
+            if (!playable(col)) {
+                continue;
+            }
+            play(col, piece);
+            m_nodes++;
+            if (depth == 1) {
+                count++;
+            } else if (!won(piece)) {
+                count += perft(depth - 1);
+            }
+            undo(col, piece);
+        }
+
+        return count;
+    } // GravityBoard::perft(int const depth)
+
+};  // class GravityBoard
+
+#endif /* gravity_h */
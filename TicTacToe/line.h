@@ -9,6 +9,9 @@
 #ifndef line_h
 #define line_h
 
+#include <cassert>
+#include <cstdint>
+
 #include <iostream>
 using std::ostream;
 
@@ -18,108 +21,147 @@ using std::map;
 
 #include "common.h"
 #include "move.h"
+#include "pattern.h"
 
 /// @brief Line represents a series of board cells with a starting offset
 /// into the board and a delta value to add to the current offset to get to
 /// the next cell in the Line.
 ///
+/// The Line's cells are a base-3 code (see pattern.h), so evaluating a Line
+/// is one table load. A game keeps its Lines in a LineTable (linetable.h),
+/// which updates the codes as pieces are placed; a Line is a small value
+/// read from one row of it.
+///
 struct Line {
 public:
-    int const   m_offset;   // position on board where this line starts
-    int const   m_delta;    // delta to add to get to next cell in this line
-    vector<int> m_cells;    // the cell's contents that make up this line
-    Move       m_results;   // results after loading the cells and analyzing
+    int const       m_offset;   // position on board where this line starts
+    int const       m_delta;    // delta to add to get to next cell in this line
+    int const       m_length;   // number of cells in this line (the game's Base)
+    int const       m_grid;     // width of the board this line is on
+    uint32_t const  m_code;     // base-3 encoding of the cells that make up this line
+    Pattern const  *m_patterns; // lookup table for lines of this length (or nullptr)
 
 
     string to_string(void) const {
         stringstream ss;
         ss \
-          << (m_delta == 1 ? " H" : m_delta == Grid ? " V" : m_delta == (Grid + 1) ? "D+" : "D-")
+          << (m_delta == 1 ? " H" : m_delta == m_grid ? " V" : m_delta == (m_grid + 1) ? "D+" : m_delta == (m_grid - 1) ? "D-" : "  ")
           << " { offset: " << itoa(m_offset, 10, 2)
           << " delta: " << itoa(m_delta, 10, 2)
-          << " results: " << m_results.to_string()
+          << " code: " << m_code
           << " }";
 
         return ss.str();
     } // Line::to_string()
 
+
+    /// @name cell(int const i) const
+    /// @returns the board index of cell i of this Line
+    inline int cell(int const i) const {
+        return m_delta * i + m_offset;
+    } // Line::cell(int const i)
+
+
+    /// @name pattern() const
+    /// @returns the Pattern for this Line's current cells
+    inline Pattern pattern() const {
+        return m_patterns ? m_patterns[m_code] : classify(m_code, m_length);
+    } // Line::pattern()
+
+
     /**
+     * @summary: classify this Line with a single lookup of its encoding
+     *           in the pattern table for its length.
      *
+     * @returns: the Move this Line offers. RANDOM1 and RANDOM2 Moves carry
+     *           the open cells as their choices.
      */
-    Move evaluate(const int board[]) {
-        vector<int> moves, randset;
-        map<int, int> values;
-        int which;
-
-        m_cells.clear();
-        for (int i=0; i < Base; ++i) {
-            const int index = m_delta * i + m_offset;
-            m_cells.push_back(board[index]);
-            moves.push_back(index);
-        }
-        
-        // count the value occurrances for 0, 1, or 2 for this line
-        for (int i=0; i < m_cells.size(); ++i) {
-            const int c = m_cells[i];
-            if (c == 0) randset.push_back(m_delta * i + m_offset);
-            values[c]++;
-        }
+    Move evaluate() const {
+        Pattern const p = pattern();
+        vector<int> cells;
 
-        which = randset.empty() ? 0 : randset[rand() % randset.size()];
-        const pair<const int, const int> &entry = *(values.begin());
-        switch (values.size()) {
-            case 3:
-                // this line involves both players (values 1 and 2) and empty spots (value 0)
-                if (Grid - randset.size() >= Base) {
-                    return Move(RANDOM1, which, randset);
+        switch (p.key) {
+            case WINNER:
+                // the game has been won.
+                // remember the indexes of the winning spots
+                for (int i=0; i < m_length; ++i) {
+                    cells.push_back(cell(i));
                 }
-                return Move(RANDOM2, which, randset);
+                return Move(WINNER, p.owner, cells);
 
-            case 2:
-                // only 2 values involved; (0,1), (0, 2), or (1, 2)
-                if (entry.first == 0) {                     // if there are empty spot(s)
-                    if (entry.second <= 1) {                // and only 1 empty spot
-                        return Move(FORCED, which);        // we know we only have one empty (0) so randset[0] is it's index
-                    }
-                    return Move(RANDOM1, which, randset);  // pick from one of the empty spots
-                }
+            case NOMOVE:
                 return Move(NOMOVE, 0);
 
-            case 1:
-                // all cells have the same value
-                if (entry.first == 0) {                     // if they are all empty
-                    return Move(RANDOM1, which, randset);  // pick one of them
-                }
+            case FORCED:
+                return Move(FORCED, cell(m_length <= 16 ? p.first() : open_cells()[0]));
 
-                // the game has been won.
-                // remember the indexes of the winning spots
-                for (int i=0; i < m_cells.size(); ++i) {
-                    randset.push_back(m_delta * i + m_offset);
+            case RANDOM1:
+            case RANDOM2:
+                if (m_length <= 16) {
+                    for (uint32_t bits = p.open; bits; bits &= bits - 1) {
+                        cells.push_back(cell(__builtin_ctz(bits)));
+                    }
+                } else {
+                    for (int i : open_cells()) {
+                        cells.push_back(cell(i));
+                    }
                 }
-
-                return Move(WINNER, entry.first, moves);
+                return Move(p.resolve(m_grid, m_length), cells[0], cells);
 
             default:
-                std::cerr << "error - values.size() = " << values.size() << "\n";
+                std::cerr << "error - invalid pattern for line code " << m_code << "\n";
                 break;
         }
 
         assert(false);
+        return Move();
     } // Line::evaluate()
-    
 
-public:
-    Line(int const offset, int const delta) :
-        m_offset(offset),
-        m_delta(delta) {
-    } // Line::Line(int const offset, int const delta)
 
+    /// @name for_open(Pattern const &p, F const &f) const
+    /// @brief call f(board index) for each open cell of this Line; 'p' is its pattern()
+    template <typename F>
+    inline void for_open(Pattern const &p, F const &f) const {
+        if (m_length <= 16) {
+            for (uint32_t bits = p.open; bits; bits &= bits - 1) {
+                f(cell(__builtin_ctz(bits)));
+            }
+        } else {
+            for (int const i : open_cells()) {
+                f(cell(i));
+            }
+        }
+    } // Line::for_open(...)
+
+
+    /// @name open_cells() const
+    /// @brief decode the open positions of a Line too long for the pattern masks
+    vector<int> open_cells() const {
+        vector<int> open;
+        uint32_t code = m_code;
+        for (int i=0; i < m_length; ++i, code /= 3) {
+            if (code % 3 == 0) open.push_back(i);
+        }
+        return open;
+    } // Line::open_cells()
 
-    inline Move process(int const board[]) {
-        m_results = evaluate(board);
 
-        return m_results;
-    } // Line::process(...)
+public:
+    inline Line(int const offset, int const delta, int const length, int const grid,
+                uint32_t const code, Pattern const *patterns) :
+        m_offset(offset),
+        m_delta(delta),
+        m_length(length),
+        m_grid(grid),
+        m_code(code),
+        m_patterns(patterns) {
+    } // Line::Line(...)
+
+
+    Line(int const offset, int const delta, int const length, int const grid) :
+        Line(offset, delta, length, grid, 0, pattern_table(length)) {
+        assert(length <= MaxLineBase);
+    } // Line::Line(int const offset, int const delta, int const length, int const grid)
 
 };  // class Line
 
@@ -0,0 +1,108 @@
+///
+///  @file linetable.h
+///  @brief the declaration and definition of the LineTable class
+///
+
+#ifndef linetable_h
+#define linetable_h
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include <vector>
+using std::vector;
+
+#include "line.h"
+#include "pattern.h"
+
+/// @brief LineTable holds every Line of a board as a structure of arrays.
+///
+/// A Line is three 32 bit words: its first cell, its delta and its code.
+/// Each of the three is a column of its own and the columns share one block
+/// of 64 byte aligned chunks, each starting on a cache line, so a pass over
+/// the codes (most of what analysis reads) walks consecutive cache lines and
+/// no word in the table points anywhere. The length, board width and
+/// pattern table are the same for every Line and are kept once. The 1,020
+/// Lines of five on a 19x19 board take 12KB.
+///
+/// operator[] reads a row into a Line value; codes only change through
+/// place() and unplace().
+///
+class LineTable {
+private:
+    struct alignas(64) Chunk {
+        uint32_t    words[16];
+    };
+
+    enum { OFFSET, DELTA, CODE, COLUMNS };
+
+    vector<Chunk>   m_chunks;
+    int             m_size;
+    int             m_stride;       // words in each column: m_size rounded up to whole chunks
+    int             m_length;
+    int             m_grid;
+    Pattern const  *m_patterns;     // the shared pattern table for Lines of m_length (or nullptr)
+
+    inline uint32_t *column(int const c) {
+        return reinterpret_cast<uint32_t *>(m_chunks.data()) + size_t(c) * m_stride;
+    }
+
+    inline uint32_t const *column(int const c) const {
+        return reinterpret_cast<uint32_t const *>(m_chunks.data()) + size_t(c) * m_stride;
+    }
+
+public:
+    LineTable() : m_size(0), m_stride(0), m_length(0), m_grid(0), m_patterns(nullptr) {}
+
+
+    /// @name assign(int const length, int const grid, vector<int> const &offsets, vector<int> const &deltas)
+    /// @brief hold the Lines with these first cells and deltas, all empty
+    void assign(int const length, int const grid, vector<int> const &offsets, vector<int> const &deltas) {
+        assert(offsets.size() == deltas.size() && length <= MaxLineBase);
+        m_size = int(offsets.size());
+        m_stride = (m_size + 15) & ~15;
+        m_length = length;
+        m_grid = grid;
+        m_patterns = pattern_table(length);
+        m_chunks.assign(size_t(m_stride / 16) * COLUMNS, Chunk {});
+        std::copy(offsets.begin(), offsets.end(), column(OFFSET));
+        std::copy(deltas.begin(), deltas.end(), column(DELTA));
+    } // LineTable::assign(...)
+
+
+    int size() const { return m_size; }
+    size_t bytes() const { return m_chunks.size() * sizeof(Chunk); }
+
+
+    /// @returns Line n as it stands
+    inline Line operator [] (int const n) const {
+        return Line(int(column(OFFSET)[n]), int(column(DELTA)[n]), m_length, m_grid, column(CODE)[n], m_patterns);
+    }
+
+    inline uint32_t code(int const n) const { return column(CODE)[n]; }
+
+    inline Pattern pattern(int const n) const {
+        uint32_t const code = column(CODE)[n];
+        return m_patterns ? m_patterns[code] : classify(code, m_length);
+    }
+
+
+    /// @brief update Line n's code for a piece placed on its cell i
+    inline void place(int const n, int const i, int const piece) {
+        column(CODE)[n] += uint32_t(piece) * Pow3[i];
+    }
+
+    /// @brief update Line n's code for a piece taken back off its cell i
+    inline void unplace(int const n, int const i, int const piece) {
+        column(CODE)[n] -= uint32_t(piece) * Pow3[i];
+    }
+
+    /// @brief empty every Line
+    void clear() {
+        std::fill(column(CODE), column(CODE) + m_stride, 0u);
+    }
+
+};  // class LineTable
+
+#endif /* linetable_h */
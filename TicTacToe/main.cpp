@@ -8,6 +8,7 @@
  *
  */
 
+#include <cassert>
 #include <iostream>
 #include <sstream>
 #include <cstring>
@@ -15,10 +16,31 @@
 #include <ctype.h>
 #include <time.h>
 #include <map>
+#include <unordered_map>
+#include <csignal>
+#include <thread>
+#include <sys/resource.h>
 
 #include "common.h"
 #include "move.h"
 #include "line.h"
+#include "game.h"
+#include "timecontrol.h"
+#include "search.h"
+#include "ponder.h"
+#include "server.h"
+#include "enumerate.h"
+#include "solver.h"
+#include "export.h"
+#include "gravity.h"
+#include "sparse.h"
+#include "verify.h"
+#include "renderer.h"
+#include "match.h"
+#include "perfcounters.h"
+#include "stats.h"
+#include "checkpoint.h"
+#include "sessions.h"
 
 using std::stringstream;
 using std::ostream;
@@ -29,9 +51,9 @@ using std::cin;
 using std::map;
 
 #ifdef GRID
-const int Grid   = GRID;
+int       Grid   = GRID;
 #else
-const int Grid   = 7;
+int       Grid   = 7;
 #endif
 
 #ifdef BASE
@@ -41,12 +63,26 @@ int       Base   = 7;
 #endif
 
 int       DbgLvl = 1;
+bool      Gravity     = false;
+int       Dims        = 2;
+int       Radius      = 0;
 bool      Human       = false;
+bool      Pondering   = true;
 bool      UseCoords   = true;
 bool      Legend      = true;
 bool      ShowChoices = false;
 bool      UseAnsi     = false;
 
+TimeControl Clock;
+
+Renderer   *Screen = nullptr;   // draws self-play and human games in place when -watch is given
+string      Standings;          // the run's results so far, for the Screen's status line
+
+// the phases of an engine move that -perf measures
+enum { PHASE_THINK, PHASE_MOVE, PHASE_ANALYZE };
+PhaseProfile *Profile = nullptr;
+GameStats  *Stats = nullptr;    // outcome tables for -stats, shared by every game thread
+
 ///
 /// @
 ///
@@ -88,461 +124,734 @@ string const to_string(vector<int> const &v) {
 } // to_string(vector<int> const &v)
 
 
-class InARowGame {
-public:
-    static char constexpr m_dispPieces[3] { '.', 'O', 'X' };
-    int           m_board[Grid * Grid];
-    vector<Line>  m_lines;
-    int           m_lastmove;
-    vector<int>   m_windexes;
-    vector<Move> m_history;
-    double        m_tm_total;
 
-public:
+void playback(InARowGame &board) {
+    vector<Move> moves = board.m_history;
+    Move result;
+
+    board.init();
+    for (int i=0; i < moves.size(); ++i)  {
+        result = moves[i];
+        debug(1, cout << "\nturn " << i + 1 << ":\n");
+        board.display();
+        board.make_move(result, (i + 1) & 1, ShowChoices);
+        result = board.analyze();
+        if (result.key == NOMOVE || result.key == WINNER) {
+            break;
+        }
+    }
+}
 
+Move tictactoe(InARowGame &board) {
+    Move result;
+    Searcher engine(Clock);
+    Ponderer ponder(engine);
+    TimeUsed timer(board.m_tm_total);
 
-    InARowGame() {
-        init();
-        m_tm_total = 0.0;
-    } // InARowGame::InARowGame()
+    Clock.new_game();
 
-    
-    void init() {
-        init_board();
-        init_lines();
-    } // InARowGame::init()
-
-    // perform a sanity check on a board index
-    void validate_index(const int index, string const &errmsg="", const int stop=0) {
-        if (index < 0 || index >= Grid * Grid) {
-            cout << "invalid board index: " << index << " " << errmsg;
-            if (stop) assert(false);
+    int const spots = int(board.m_board.size());
+    for (int turn=1; turn <= spots; ++turn) {
+        if (Screen) {
+            Screen->frame(board, Standings + "   turn " + commas(turn));
+        } else {
+            debug(1, cout << "\nturn = " << commas(turn) << "\n");
+            board.display();
+        }
+        if (Human && Pondering) {
+            result = ponder.process(board, turn & 1);
+        } else if (Human && (turn & 1)) {
+            result = board.process(turn & 1);
+        } else if (Profile) {
+            // board.process() with each phase charged on its own
+            Profile->start();
+            Move const move = engine.think(board, turn & 1);
+            Profile->charge(PHASE_THINK);
+            board.make_move(move, turn & 1, ShowChoices);
+            Profile->charge(PHASE_MOVE);
+            result = board.analyze();
+            Profile->charge(PHASE_ANALYZE);
+        } else {
+            result = board.process(turn & 1, engine.think(board, turn & 1));
+        }
+        if (result.key == NOMOVE || result.key == WINNER) {
+            break;
         }
     }
 
+    if (Human && Pondering) {
+        debug(1, cout << "ponder hits: " << ponder.hits() << " misses: " << ponder.misses() << "\n");
+    }
+    
+    return result;
+} // tictactoe(InARowGame &board)
 
-    // perform a sanity check on a line
-    void validate_line(Line const &line, string const &errmsg="", const int stop=0) {
-        // validate the member values
-        validate_index(line.m_offset, "m_offset", 1);
 
-        for (int i=0; i < Base; ++i) {
-            int index = line.m_offset + line.m_delta * i;
-            stringstream ss;
-            ss << "line cell member " << i << " ";
-            validate_index(index, ss.str(), 1);
-        }
-    };
+//#include <unistd.h> // for sleep()
 
-    void init_lines() {
-        assert(Grid >= Base);
-        const int slack = Grid - Base;
-        
-        m_lines.clear();
-
-        debug(2, cout << "Generated Lines:\n");
-
-        // create horizontal lines
-        for (int i=0; i < Grid; ++i) {
-            for (int k=0; k <= slack; ++k) {
-                debug(3, cout << ".");
-                stringstream ss;
-                ss << "Check Line: " << i << " ";
-                m_lines.push_back( { Grid * i + k, 1 } );
-                validate_line(m_lines.back(), ss.str(), 1);
-            }
-        }
 
-        // create vertical lines
-        for (int i=0; i < Grid; ++i) {
-            for (int k=0; k <= slack; ++k) {
-                debug(3, cout << ".");
-                stringstream ss;
-                ss << "Check Line: " << i << " ";
-                m_lines.push_back( { i + k * Grid, Grid } );
-                validate_line(m_lines.back(), ss.str(), 1);
-            }
-        }
+#include <tuple>
+using std::tuple;
 
-        // create diagonal lines
-        for (int i=0; i <= slack; ++i) {
-            for (int k=0; k <= slack; ++k) {
-                debug(3, cout << "..");
-                stringstream ss;
-                m_lines.push_back( { Grid * i + k, Grid + 1 } );
-                ss << "Check Line: " << i << " ";
-                validate_line(m_lines.back(), ss.str(), 1);
-
-                ss.clear();
-                ss << "Check Line: " << i << " ";
-                m_lines.push_back( { Grid * i + ((Grid - 1) - k), Grid - 1 } );
-                validate_line(m_lines.back(), ss.str(), 1);
+map<string, string> options;
+
+/**
+ * @summary process_param(..) Parse one option starting at argv[index]
+ *
+ * Accepts "-key value", "--key value", "-key=value", "key = value",
+ * "key : value", and a bare "-flag" (which gets the value "1"). A value
+ * may be a negative number ("-elo0 -5"); anything else starting with "-"
+ * is the next option.
+ *
+ * @param index  the argument to start at; left on the last argument used
+ *
+ * @returns the { key, value } pair
+ */
+tuple<string, string> process_param(int argc, char * argv[], int &index) {
+    string key = argv[index];
+    string value;
+
+    // strip the "-" or "--" prefix
+    while (!key.empty() && key[0] == '-') {
+        key.erase(0, 1);
+    }
+
+    size_t const split = key.find_first_of("=:");
+    if (split != string::npos) {
+        value = key.substr(split + 1);
+        key = key.substr(0, split);
+        return { key, value };
+    }
+
+    if (index + 1 < argc) {
+        string param = argv[index + 1];
+        if (param == "=" || param == ":") {
+            index++;
+            if (index + 1 < argc) {
+                value = argv[++index];
             }
+            return { key, value };
         }
-        debug(3, cout << "\n");
-
-        int num = 0;
-        for (auto const &line : m_lines) {
-            debug(2, cout << itoa(num++, 10, 3) << " " << line.to_string() << "\n");
+        char *end = nullptr;
+        bool const negative = param.size() > 1 && param[0] == '-' && (strtod(param.c_str(), &end), *end == '\0');
+        if (!param.empty() && (param[0] != '-' || negative)) {
+            value = param;
+            index++;
+            return { key, value };
         }
-        debug(2, cout << "\n");
-        
-    } // InARowGame::init_lines()
+    }
 
-    
-    void init_board() {
-        for (int n=0; n < Grid * Grid; ++n) {
-            m_board[n] = 0;
+    return { key, "1" };
+}
+
+int process_cmdline(int argc, char *argv[]) {
+    for (int index=1; index < argc; ++index) {
+        string param = argv[index];
+        if (param.empty()) {
+            continue;
         }
-        m_windexes.clear();
-        m_lastmove = -1;
-        m_history.clear();
-    } // InARowGame::init_board()
-
-
-    void show_lines() {
-        int num = 1;
-        for (const Line& line : m_lines) {
-            init_board();
-            for (int i=0; i < Base; ++i) {
-                m_board[line.m_offset + line.m_delta * i] = 2;
-            }
-            debug(1, cout << "Line " << num++ << ":\n");
-            display();
-            debug(1, cout << "\n");
+
+        tuple<string, string> result = process_param(argc, argv, index);
+        string const key = std::get<0>(result);
+        string const value = std::get<1>(result);
+        if (!key.empty()) {
+            options[key] = value;
         }
     }
 
+    return 0;
+}
 
-    void display(bool showLegend=Legend) {
-        string legend;
+/**
+ * @summary enumerate() Count every legal game of the default geometry exactly
+ *
+ * @returns the process exit code
+ */
+int enumerate() {
+    if (Gravity) {
+        cerr << "enumeration only counts games without gravity\n";
+        return 1;
+    }
+    if (Grid * Grid > Enumerator::MaxCells) {
+        cerr << "enumeration is limited to " << Enumerator::MaxCells << " cells\n";
+        return 1;
+    }
 
-        if (showLegend) {
-            legend = "  ";
-            for (int index=0; index < Grid; ++index) {
-                legend += itoa(index, 26, 2);
-            }
-            legend += "\n";
-        }
+    size_t const threads = options.count("threads") ? size_t(atoi(options["threads"].c_str())) : 0;
+    Enumerator walker(Grid, Base);
 
-        debug(1, cout << legend);
+    auto const start = steady_clock::now();
+    Enumerator::Tally const total = walker.run(threads);
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
 
-        for (int index=0; index < Grid * Grid; ++index) {
-            bool highlight = index == m_lastmove;
-            for (const int & w : m_windexes) {
-                if (w == index) {
-                    highlight = true;
-                    break;
-                }
-            }
+    cout << "Grid Width: " << Grid << "\n";
+    cout << "In-A-Row: " << Base << "\n";
+    cout << "Total games: " << Enumerator::to_string(total.games) << "\n";
+    cout << "X wins: " << Enumerator::to_string(total.ends[2]) << "\n";
+    cout << "O wins: " << Enumerator::to_string(total.ends[1]) << "\n";
+    cout << "Draws: " << Enumerator::to_string(total.ends[0]) << "\n";
+    cout << "Distinct positions (up to symmetry): " << Enumerator::to_string(walker.positions()) << "\n";
+    cout << "Distinct finished positions (up to symmetry): " << Enumerator::to_string(walker.terminals()) << "\n";
+    cout << "Nodes: " << Enumerator::to_string(walker.nodes()) << "\n";
 
-            legend.clear();
-            if ((index % Grid == 0) && showLegend) {
-                legend = " ";
-                legend += 'A' + index / Grid;
-                legend += " ";
-            }
+    char buff[128];
+    sprintf(buff, "%g", seconds);
+    cout << "Total time: " << buff << " seconds\n";
+    sprintf(buff, "%.0f", walker.nodes() / std::max(seconds, 1e-9));
+    cout << "Nodes/sec: " << buff << "\n";
 
-            debug(1, cout
-                << legend
-                << (UseAnsi && highlight ? boldAttr : "")
-                << m_dispPieces[m_board[index]]
-                << (UseAnsi && highlight ? resetAttr : "")
-                <<  (index % Grid < (Grid-1) ? " " : "\n"));
-        }
-    } // InARowGame::display()
-
-
-    Move human_move() const {
-        while (true) {
-            cout << "Enter the square to move to (0-" << (Grid * Grid) - 1 << "): ";
-            cout.flush();
-            int n = -1;
-            if (Legend) {
-                string in;
-                cin >> in;
-                if (in.length() == 2) {
-                    char c1 = tolower(in[0]);
-                    char c2 = tolower(in[1]);
-                    c1 -= 'a';
-                    if (c2 >= 'a') {
-                        c2 -= 'a';
-                    } else {
-                        c2 -= '0';
+    return 0;
+} // enumerate()
+
+
+// set by SIGINT so a long solve can write its checkpoint before exiting
+static std::atomic<bool> Interrupted(false);
+
+/**
+ * @summary solve() Prove the game-theoretic value of the default geometry
+ *
+ * @returns the process exit code
+ */
+int solve() {
+    size_t const megabytes = options.count("ttmb") ? size_t(atoi(options["ttmb"].c_str())) : 256;
+    double const interval = options.count("interval") ? atof(options["interval"].c_str()) : 60.0;
+    string const checkpoint = options.count("checkpoint") ? options["checkpoint"] : "";
+
+    InARowGame board(Grid, Base);
+    Solver solver(board, std::max(megabytes, size_t(1)));
+    solver.set_checkpoint(checkpoint, interval);
+    solver.set_stop(&Interrupted);
+
+    if (!checkpoint.empty() && solver.load(checkpoint)) {
+        cout << "resuming from " << checkpoint << "\n";
+    }
+
+    uint64_t const resumed = solver.nodes();
+    std::signal(SIGINT, [](int) { Interrupted = true; });
+
+    auto const start = steady_clock::now();
+    Solver::value_e const value = solver.solve();
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    if (!checkpoint.empty() && !solver.save(checkpoint)) {
+        cerr << "could not write checkpoint " << checkpoint << "\n";
+    }
+
+    static char const * const names[] = { "unknown (stopped)", "X wins", "O wins", "Draw" };
+    cout << "Grid Width: " << Grid << "\n";
+    cout << "In-A-Row: " << Base << "\n";
+    cout << "Result: " << names[value] << "\n";
+    cout << "Nodes: " << Enumerator::to_string(solver.nodes()) << "\n";
+    cout << "Proven: " << Enumerator::to_string(solver.proven()) << "\n";
+    cout << "Disproven: " << Enumerator::to_string(solver.disproven()) << "\n";
+
+    char buff[128];
+    sprintf(buff, "%g", seconds);
+    cout << "Total time: " << buff << " seconds\n";
+    sprintf(buff, "%.0f", (solver.nodes() - resumed) / std::max(seconds, 1e-9));
+    cout << "Nodes/sec: " << buff << "\n";
+
+    return value == Solver::UNKNOWN ? 1 : 0;
+} // solve()
+
+
+/**
+ * @summary export_games() Play self-play games on several threads and write
+ * every position to a columnar export file
+ *
+ * @returns the process exit code
+ */
+int export_games() {
+    string const file = options["export"];
+    uint64_t const games = options.count("games") ? uint64_t(atoll(options["games"].c_str())) : 1000;
+    size_t threads = options.count("threads") ? size_t(atoi(options["threads"].c_str())) : 0;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    Exporter out(Grid, Base);
+    if (!out.open(file)) {
+        cerr << "could not create " << file << "\n";
+        return 1;
+    }
+
+    InARowGame const shape(Grid, Base);
+    GameStats stats(shape.m_cells, shape.m_lines.size());
+    if (options.count("stats")) {
+        Stats = &stats;
+    }
+
+    // the game threads share nothing but the game counter and the exporter
+    DbgLvl = 0;
+    std::atomic<uint64_t> next_game(0);
+    auto const start = steady_clock::now();
+
+    vector<std::thread> workers;
+    for (size_t t=0; t < threads; ++t) {
+        workers.emplace_back([&out, &next_game, games] {
+            InARowGame board(Grid, Base);
+            TimeControl clock = Clock;
+            Searcher engine(clock);
+            int const spots = int(board.m_board.size());
+
+            for (uint64_t id = next_game++; id < games; id = next_game++) {
+                vector<ExportRow> rows;
+                Move result;
+
+                board.init_board();
+                clock.new_game();
+                for (int turn=1; turn <= spots; ++turn) {
+                    Move const move = engine.think(board, turn & 1);
+
+                    ExportRow row;
+                    row.game = id;
+                    row.ply = uint16_t(turn - 1);
+                    row.position = board.state();
+                    row.key = uint8_t(move.key - NOMOVE);
+                    row.value = int16_t(move.value);
+                    rows.push_back(std::move(row));
+
+                    result = board.process(turn & 1, move);
+                    if (result.key == NOMOVE || result.key == WINNER) {
+                        break;
                     }
-                    n = c1 * Grid + c2;
                 }
-            } else {
-                cin >> n;
-            }
 
-            if (n < 0 || n >= (Grid * Grid) || m_board[n] != 0) {
-                cout << "invalid square.\n";
-            } else {
-                return Move(FORCED, n);
+                int8_t const outcome = int8_t(result.key == WINNER ? result.value : 0);
+                for (ExportRow &row : rows) {
+                    row.outcome = outcome;
+                }
+                out.submit(std::move(rows));
+                if (Stats) {
+                    Stats->record(board, result);
+                }
             }
+        });
+    }
+    for (std::thread &t : workers) {
+        t.join();
+    }
+    double const played = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    bool const ok = out.close();
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    cout << "Grid Width: " << Grid << "\n";
+    cout << "In-A-Row: " << Base << "\n";
+    cout << "Games: " << Enumerator::to_string(games) << "\n";
+    cout << "Rows: " << Enumerator::to_string(out.rows()) << "\n";
+    cout << "Chunks: " << Enumerator::to_string(out.chunks()) << "\n";
+    cout << "Bytes: " << Enumerator::to_string(out.bytes()) << "\n";
+
+    char buff[128];
+    sprintf(buff, "%.2f", double(out.bytes()) / std::max<double>(double(out.rows()), 1));
+    cout << "Bytes/row: " << buff << "\n";
+    sprintf(buff, "%g / %g", played, seconds);
+    cout << "Play / total time: " << buff << " seconds\n";
+    sprintf(buff, "%.0f", out.rows() / std::max(seconds, 1e-9));
+    cout << "Rows/sec: " << buff << "\n";
+
+    if (Stats) {
+        cout << "\n" << Stats->summary(shape);
+        bool const saved = Stats->save(options["stats"], shape);
+        Stats = nullptr;
+        if (!saved) {
+            cerr << "could not write " << options["stats"] << "\n";
+            return 1;
         }
-    } // InARowGame::human_move()
-
-
-    /**
-     * @summary: Analyze all lines.
-     *           The cells for each check line will be loaded from the
-     *           board and examined.
-     *
-     * @returns: { WINNER, {1 or 2} } = line contains 'Base' pieces in a row; Win.
-     *           { NOMOVE, 0 }        = no open cells available; Draw.
-     *           { FORCED, pos }      = must move at cell 'pos' to block or win.
-     *           { 0, 0 }             = lookup pattern in table
-     */
-    inline Move analyze() {
-        map<movetype_e, Move> moves;
-        map<int, map<int, int>> counts;
-        Move score;
-
-        for (Line &line : m_lines) {
-            Move s = line.process(m_board);
-            if (s.key == RANDOM1 || s.key == RANDOM2) {
-                for (int c : s.choices) {
-                    moves[s.key].choices.push_back(c);
-                    counts[s.key][c]++;
-                }
-            } else if (s.key == WINNER) {
-                moves[s.key] = s;
-                m_windexes = s.choices;
-            } else {
-                moves[s.key] = s;
+    }
+
+    if (!ok) {
+        cerr << "error writing " << file << "\n";
+        return 1;
+    }
+    return 0;
+} // export_games()
+
+
+/**
+ * @summary read_export() Decode an export file and summarize its contents
+ *
+ * @returns the process exit code
+ */
+int read_export() {
+    string const file = options["readexport"];
+    ExportReader in;
+    if (!in.open(file)) {
+        cerr << "not an export file: " << file << "\n";
+        return 1;
+    }
+
+    uint64_t rows = 0, chunks = 0, games = 0, ends[3] {};
+    uint64_t last_game = UINT64_MAX;
+    vector<ExportRow> chunk;
+    while (in.next(chunk)) {
+        chunks++;
+        rows += chunk.size();
+        for (ExportRow const &row : chunk) {
+            if (row.game != last_game) {
+                games++;
+                ends[row.outcome % 3]++;
+                last_game = row.game;
             }
         }
+    }
 
-        assert(!moves.empty());
-
-        // Maps are sorted by their keys.
-        // We take the first one since key (movetype_e) values
-        // are defined in order of their precedence
-        // thus the highest precedence score is first
-
-        score = (*(moves.rbegin())).second;
-        score.key = (*(moves.rbegin())).first;
-        size_t movetypes = moves.size();
-        size_t cp = movetypes;
-        cp = cp ? cp : 0;
-
-        if (score.key == RANDOM1 || score.key == RANDOM2) {
-            vector<int> choices;
-            int highest_count = 0;
-            for (auto count : counts[score.key]) {
-                if (count.second > highest_count)
-                    highest_count = count.second;
+    cout << "Grid Width: " << in.grid() << "\n";
+    cout << "In-A-Row: " << in.base() << "\n";
+    cout << "Chunks: " << Enumerator::to_string(chunks) << "\n";
+    cout << "Rows: " << Enumerator::to_string(rows) << "\n";
+    cout << "Games: " << Enumerator::to_string(games) << "\n";
+    cout << "X wins: " << Enumerator::to_string(ends[2]) << "\n";
+    cout << "O wins: " << Enumerator::to_string(ends[1]) << "\n";
+    cout << "Draws: " << Enumerator::to_string(ends[0]) << "\n";
+
+    return 0;
+} // read_export()
+
+
+/**
+ * @summary nnue_bench() Compare incremental network evaluation with a full
+ * recompute over the same random games
+ *
+ * @returns the process exit code
+ */
+int nnue_bench(std::shared_ptr<NnueWeights const> const &weights) {
+    int const games = options.count("games") ? atoi(options["games"].c_str()) : 20000;
+    InARowGame board(Grid, Base);
+    int const spots = int(board.m_board.size());
+    vector<int> order(spots);
+
+    // play the same random games both ways: incrementally and from scratch
+    auto play = [&](bool const incremental, uint64_t &evals, int64_t &checksum) {
+        NnueAccumulator full;
+        Rng rng(12345);
+
+        board.m_nnue.attach(incremental ? weights : nullptr, board);
+        auto const start = steady_clock::now();
+
+        for (int g=0; g < games; ++g) {
+            board.init_board();
+            for (int n=0; n < spots; ++n) {
+                order[n] = n;
             }
-            for (auto count : counts[score.key]) {
-                if (count.second == highest_count)
-                    choices.push_back(count.first);
+            for (int ply=0; ply < spots; ++ply) {
+                std::swap(order[ply], order[ply + int(rng.below(uint32_t(spots - ply)))]);
+                board.place(order[ply], (ply & 1) ? 1 : 2);
+                if (incremental) {
+                    checksum += board.m_nnue.evaluate();
+                } else {
+                    full.attach(weights, board);
+                    checksum += full.evaluate();
+                }
+                evals++;
             }
-            score.choices = choices;
         }
 
-        switch (score.key) {
-            case WINNER:
-                debug(1, cout << "\n");
-                display();
-                debug(1, cout << "\n" << m_dispPieces[score.value] << " Wins!\n");
-                return score;
+        return std::chrono::duration<double>(steady_clock::now() - start).count();
+    };
 
-            case NOMOVE:
-                debug(1, cout << "\n");
-                display();
-                debug(1, cout << "\nDraw!\n");
-                return score;
-
-            case FORCED:
-                return score;
-
-            case RANDOM1:
-                score.value = score.choices[rand() % score.choices.size()];
-                return score;
-
-            case RANDOM2:
-                score.value = score.choices[rand() % score.choices.size()];
-                return score;
-
-            case ZERO:
-            default:
-                display();
-                cout << "invalid Move (move stance): " << score.to_string() << "\n";
-                if (score.key == ZERO)
-                    cout << "Move stance is ZERO - must choose at least one available move from all Lines.\n";
-                assert(false);
-                break;
-        }
+    uint64_t inc_evals = 0, full_evals = 0;
+    int64_t inc_sum = 0, full_sum = 0;
+    double const inc_time = play(true, inc_evals, inc_sum);
+    double const full_time = play(false, full_evals, full_sum);
 
-        assert(false);
-    } // InARowGame::analyze()
+#if defined(__AVX2__)
+    cout << "Accumulator: AVX2\n";
+#else
+    cout << "Accumulator: scalar\n";
+#endif
+    cout << "Grid Width: " << Grid << "\n";
+    cout << "In-A-Row: " << Base << "\n";
+    cout << "Evaluations: " << Enumerator::to_string(inc_evals) << "\n";
 
+    char buff[128];
+    sprintf(buff, "%.0f", inc_evals / std::max(inc_time, 1e-9));
+    cout << "Incremental evals/sec: " << buff << "\n";
+    sprintf(buff, "%.0f", full_evals / std::max(full_time, 1e-9));
+    cout << "Full recompute evals/sec: " << buff << "\n";
+    sprintf(buff, "%.1fx", full_time / std::max(inc_time, 1e-9));
+    cout << "Speedup: " << buff << "\n";
+    cout << "Results match: " << (inc_sum == full_sum ? "yes" : "NO") << "\n";
 
-    Move make_move(Move const &result, const int turn, bool flag=true) {
-        const int player = ((turn == 0) ? 1 : 2);
+    return inc_sum == full_sum ? 0 : 1;
+} // nnue_bench()
 
-        switch (result.key) {
-            case ZERO:
-                assert(false);
-
-            case NOMOVE:    // no open spots are available?
-                return result;
-                
-            case WINNER:    // game has been won
-                assert(m_windexes.size() == Base);
-                return result;
-
-            case FORCED:    // must move to spot to either block or win?
-                m_history.push_back(result);
-                m_lastmove = result.value;
-                m_board[m_lastmove] = player;
-                debug(1, cout << "making move: " << result.to_string(flag) << "\n");
-                return result;
-
-            case RANDOM1:
-                m_history.push_back(result);
-                m_lastmove = result.value;
-                m_board[m_lastmove] = player;
-                debug(1, cout << "making move: " << result.to_string(flag) << "\n");
-                return result;
-
-            case RANDOM2:
-                m_history.push_back(result);
-                m_lastmove = result.value;
-                m_board[m_lastmove] = player;
-                debug(1, cout << "making move: " << result.to_string(flag) << "\n");
-                return result;
-        }
 
-        assert(false);
-    } // InARowGame::make_move(Move const &result, int turn)
+/**
+ * @summary verify() Check every fast evaluation path against the reference
+ * evaluator over random games and an enumeration of games
+ *
+ * @returns the process exit code: 1 if any evaluator diverged
+ */
+int verify(std::shared_ptr<NnueWeights const> const &weights) {
+    int const games = options.count("games") ? atoi(options["games"].c_str()) : 1000;
+    uint64_t const limit = options.count("positions") ? uint64_t(atoll(options["positions"].c_str())) : 100000;
+
+    InARowGame board(Grid, Base);
+    board.m_nnue.attach(weights, board);
+    Verifier checker(board);
+
+    auto const start = steady_clock::now();
+    DbgLvl = 0;
+    bool ok = checker.check_geometry() && checker.random_games(games);
+    uint64_t const random = checker.positions();
+    ok = ok && checker.enumerate(random + limit);
+    DbgLvl = 1;
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
 
+    if (!ok) {
+        cout << "DIVERGENCE after " << Enumerator::to_string(checker.positions()) << " positions: " << checker.error() << "\n\n";
+        board.display();
+        return 1;
+    }
 
-    inline Move process(const int turn) {
-        // get the next move
-        Move result = (Human && turn) ? human_move() : analyze();
+    cout << "Grid Width: " << Grid << "\n";
+    if (Dims > 2) {
+        cout << "Dimensions: " << Dims << "\n";
+    }
+    cout << "In-A-Row: " << Base << (Gravity ? " (gravity)" : "") << "\n";
+    cout << "Lines: " << board.m_lines.size() << " (" << commas(int(board.m_lines.bytes())) << " bytes)\n";
+    cout << "Random positions: " << Enumerator::to_string(random) << " in " << games << " games\n";
+    cout << "Enumerated positions: " << Enumerator::to_string(checker.positions() - random) << "\n";
 
-        // process the move
-        assert(result.key != ZERO);
-        make_move(result, turn, ShowChoices);
-        
-        result = analyze();
+    char buff[128];
+    sprintf(buff, "%g", seconds);
+    cout << "Total time: " << buff << " seconds\n";
+    cout << "No divergence\n";
 
-        return result;
-    } // InARowGame::process(const int turn)
+    return 0;
+} // verify()
 
 
-    string const state() const {
-        string res;
-        for (const int & c : m_board) {
-            res += m_dispPieces[c];
-        }
-        
-        return res;
+/**
+ * @summary perft() Count the gravity games of each depth on the bitboard
+ * move generator
+ *
+ * @returns the process exit code
+ */
+int perft() {
+    int const depth = atoi(options["perft"].c_str());
+    int const rows = options.count("rows") ? atoi(options["rows"].c_str()) : Grid;
+    if (!GravityBoard::fits(Grid, rows) || Base > std::max(Grid, rows)) {
+        cerr << "perft needs columns * (rows + 1) <= 64\n";
+        return 1;
     }
-    
-};  // class InARowGame
 
+    cout << "Columns: " << Grid << "\n";
+    cout << "Rows: " << rows << "\n";
+    cout << "In-A-Row: " << Base << "\n";
 
-void playback(InARowGame &board) {
-    vector<Move> moves = board.m_history;
-    Move result;
+    for (int d=1; d <= depth; ++d) {
+        GravityBoard board(Grid, rows, Base);
+        auto const start = steady_clock::now();
+        uint64_t const count = board.perft(d);
+        double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
 
-    board.init();
-    for (int i=0; i < moves.size(); ++i)  {
-        result = moves[i];
-        debug(1, cout << "\nturn " << i + 1 << ":\n");
-        board.display();
-        board.make_move(result, (i + 1) & 1, ShowChoices);
-        result = board.analyze();
-        if (result.key == NOMOVE || result.key == WINNER) {
-            break;
-        }
+        char buff[128];
+        sprintf(buff, "%.0f", board.nodes() / std::max(seconds, 1e-9));
+        cout << "perft " << d << ": " << Enumerator::to_string(count)
+             << "  (" << Enumerator::to_string(board.nodes()) << " positions, " << buff << " positions/sec)\n";
     }
-}
 
-Move tictactoe(InARowGame &board) {
-    Move result;
-    TimeUsed timer(board.m_tm_total);
-    
-    for (int turn=1; turn <= Grid * Grid; ++turn) {
-        debug(1, cout << "\nturn = " << commas(turn) << "\n");
-        board.display();
-        result = board.process(turn & 1);
-        if (result.key == NOMOVE || result.key == WINNER) {
-            break;
+    return 0;
+} // perft()
+
+
+/**
+ * @summary sparse_games() Self-play Base in a row on an unbounded board
+ *
+ * @returns the process exit code
+ */
+int sparse_games() {
+    int const games = options.count("games") ? atoi(options["games"].c_str()) : 100;
+    int const max_moves = options.count("maxmoves") ? atoi(options["maxmoves"].c_str()) : 10000;
+
+    int results[3] {};      // draws, 'O' wins, 'X' wins
+    uint64_t moves = 0;
+    int most_stones = 0;
+    size_t most_lines = 0, most_bytes = 0;
+    auto const start = steady_clock::now();
+
+    for (int g=0; g < games; ++g) {
+        SparseGame game(Base);
+        int winner = 0;
+
+        for (int ply=0; ply < max_moves && winner == 0; ++ply) {
+            int const mover = (ply & 1) ? 1 : 2;
+            SparseGame::Move const m = game.think(mover);
+            if (game.place(m.x, m.y, mover)) {
+                winner = mover;
+            }
+            moves++;
         }
-    }
-    
-    return result;
-} // tictactoe(InARowGame &board)
 
+        results[winner]++;
+        most_stones = std::max(most_stones, game.stones());
+        most_lines = std::max(most_lines, game.lines());
+        most_bytes = std::max(most_bytes, game.bytes());
 
-//#include <unistd.h> // for sleep()
+        if (DbgLvl > 1 || g + 1 == games) {
+            debug(1, game.display());
+            debug(1, cout << (winner ? string(1, ".OX"[winner]) + " Wins!" : string("Draw!")) << "\n\n");
+        }
+    }
 
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
 
-#include <tuple>
-using std::tuple;
+    cout << "In-A-Row: " << Base << " (unbounded board)\n";
+    cout << "Total games: " << games << "\n";
+    cout << "X wins: " << results[2] << "\n";
+    cout << "O wins: " << results[1] << "\n";
+    cout << "Draws (" << max_moves << " moves): " << results[0] << "\n";
+    cout << "Moves: " << Enumerator::to_string(moves) << "\n";
+    cout << "Most stones: " << most_stones << "  Lines: " << most_lines << "  Table bytes: " << most_bytes << "\n";
 
-map<string, string> options;
+    char buff[128];
+    sprintf(buff, "%g", seconds);
+    cout << "Total time: " << buff << " seconds\n";
+    sprintf(buff, "%.0f", moves / std::max(seconds, 1e-9));
+    cout << "Moves/sec: " << buff << "\n";
 
-tuple<string, string> process_param(int argc, char * argv[]) {
-    enum { PARM_KEY, PARM_VALUE } state = PARM_KEY;
-    string key, value;
+    return 0;
+} // sparse_games()
 
-    for (int index=1; index < argc; ++index) {
-        string param = argv[index];
 
-        switch (state) {
-            case PARM_KEY:
-                key = param;
-                state = PARM_VALUE;
-                continue;
+/**
+ * @summary match() Play two engine configurations against each other with
+ * alternating colors until a sequential probability ratio test decides
+ *
+ * @returns the process exit code: 0 if the first engine passed, 1 if not
+ * or the test ran out of games
+ */
+int match() {
+    uint64_t const games = uint64_t(atoll(options["match"].c_str()));
+    size_t const threads = options.count("threads") ? size_t(atoi(options["threads"].c_str())) : 0;
+    double const elo0 = options.count("elo0") ? atof(options["elo0"].c_str()) : 0.0;
+    double const elo1 = options.count("elo1") ? atof(options["elo1"].c_str()) : 10.0;
+    double const alpha = options.count("alpha") ? atof(options["alpha"].c_str()) : 0.05;
+    double const beta = options.count("beta") ? atof(options["beta"].c_str()) : 0.05;
+    int const cells = InARowGame::cells(Grid, Dims);
+    int const lines = int(InARowGame(Grid, Base).m_lines.size());
+
+    if (games == 0 || elo1 <= elo0 || alpha <= 0.0 || alpha >= 1.0 || beta <= 0.0 || beta >= 1.0) {
+        cerr << "-match needs a game limit, -elo1 above -elo0 and -alpha, -beta between 0 and 1\n";
+        return 1;
+    }
 
-            case PARM_VALUE:
-                if (param != "=" && param != ":") {
-                    value = param;
-                    return { key, value };
-                }
-                state = PARM_VALUE;
-                break;
+    EngineConfig engines[2];
+    for (int e=0; e < 2; ++e) {
+        string const key = "engine" + itoa(e + 1);
+        string error;
+        if (!engines[e].parse(options.count(key) ? options[key] : "", cells, Base, lines, error)) {
+            cerr << "-" << key << ": " << error << "\n";
+            return 1;
         }
     }
 
-    return { key, value };
-}
+    seed_random(uint64_t(time(nullptr)));
+    DbgLvl = 0;
+    Match contest(engines[0], engines[1], Sprt(elo0, elo1, alpha, beta), 100);
+    auto const start = steady_clock::now();
+    Sprt::status_e const verdict = contest.run(games, threads);
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+    DbgLvl = 1;
 
-int process_cmdline(int argc, char *argv[]) {
-    for (int index=1; index < argc; ++index) {
-        string param = argv[index];
-        if (!param.empty()) {
-            string key, value;
-
-            if (!param.empty() && param[0] == '-') {
-                param = &param[1]; // strip it
-                if (!param.empty() && param[0] != '-') {
-                    // handle "-" prefixed option
-                    param = &param[1];
-
-                    tuple<string, string> result = process_param(argc, argv);
-                    key = std::get<0>(result);
-                    value = std::get<1>(result);
-                } else {
-                    // handle "--" prefixed option
-                    param = &param[1]; // strip it
+    Sprt const &sprt = contest.sprt();
+    double low, high;
+    double const elo = sprt.elo(low, high);
+    char buff[128];
 
-                    tuple<string, string> result = process_param(argc, argv);
-                    key = std::get<0>(result);
-                    value = std::get<1>(result);
-                }
-            }
-        }
+    cout << "\n";
+    cout << "Engine 1: " << engines[0].spec << "\n";
+    cout << "Engine 2: " << engines[1].spec << "\n";
+    cout << "Grid Width: " << Grid << "\n";
+    cout << "In-A-Row: " << Base << "\n";
+    cout << "Games: " << commas(int(sprt.games())) << " of " << commas(int(games)) << "\n";
+    cout << "Engine 1 wins / draws / losses: " << commas(int(sprt.wins())) << " / "
+         << commas(int(sprt.draws())) << " / " << commas(int(sprt.losses())) << "\n";
+    cout << "  playing X: " << commas(int(contest.colored(true, 0))) << " / " << commas(int(contest.colored(true, 1)))
+         << " / " << commas(int(contest.colored(true, 2))) << "\n";
+    cout << "  playing O: " << commas(int(contest.colored(false, 0))) << " / " << commas(int(contest.colored(false, 1)))
+         << " / " << commas(int(contest.colored(false, 2))) << "\n";
+    sprintf(buff, "%+.1f (95%% confidence %+.1f to %+.1f)", elo, low, high);
+    cout << "Elo: " << buff << "\n";
+    sprintf(buff, "%.2f (%.2f, %.2f) for elo0 %g elo1 %g alpha %g beta %g", sprt.llr(), sprt.lower(), sprt.upper(), elo0, elo1, alpha, beta);
+    cout << "LLR: " << buff << "\n";
+    cout << "SPRT: " << (verdict == Sprt::ACCEPT_H1 ? "H1 accepted" : verdict == Sprt::ACCEPT_H0 ? "H0 accepted" : "undecided") << "\n";
+    sprintf(buff, "%g", seconds);
+    cout << "Total time: " << buff << " seconds\n";
+
+    return verdict == Sprt::ACCEPT_H1 ? 0 : 1;
+} // match()
+
+
+/**
+ * @summary sessions() Host many games at once as coroutine sessions on a
+ * few threads, with simulated clients playing X
+ *
+ * @returns the process exit code
+ */
+int sessions() {
+#ifdef HAVE_SESSIONS
+    uint64_t const count = uint64_t(atoll(options["sessions"].c_str()));
+    size_t const threads = options.count("threads") ? size_t(atoi(options["threads"].c_str())) : 0;
+    if (count == 0) {
+        cerr << "-sessions needs the number of games to host\n";
+        return 1;
     }
 
+    GameStats stats(InARowGame::cells(Grid, Dims), int(InARowGame(Grid, Base).m_lines.size()));
+    if (options.count("stats")) {
+        Stats = &stats;
+    }
+
+    DbgLvl = 0;
+    GameSessions host(threads, Stats);
+    auto const start = steady_clock::now();
+    host.run(count);
+    double const seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+    DbgLvl = 1;
+
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    double const peak = double(usage.ru_maxrss);            // bytes
+#else
+    double const peak = double(usage.ru_maxrss) * 1024.0;   // kilobytes
+#endif
+    char buff[128];
+
+    cout << "Grid Width: " << Grid << "\n";
+    cout << "In-A-Row: " << Base << "\n";
+    cout << "Sessions: " << commas(int(count)) << " at once on " << host.scheduler().threads() << " threads\n";
+    cout << "X wins / O wins / draws: " << commas(int(host.results(2))) << " / " << commas(int(host.results(1)))
+         << " / " << commas(int(host.results(0))) << "\n";
+    cout << "Moves: " << commas(int(host.moves())) << "\n";
+    sprintf(buff, "%.1f", double(host.scheduler().resumes()) / count);
+    cout << "Resumes: " << commas(int(host.scheduler().resumes())) << " (" << buff << " per session)\n";
+    cout << "Session frame: " << commas(int(host.frame())) << " bytes\n";
+    sprintf(buff, "%.1f MB (%.1f KB per session)", peak / (1 << 20), peak / 1024.0 / count);
+    cout << "Peak memory: " << buff << "\n";
+    sprintf(buff, "%g", seconds);
+    cout << "Total time: " << buff << " seconds\n";
+    sprintf(buff, "%.0f", count / std::max(seconds, 1e-9));
+    cout << "Games/sec: " << buff << "\n";
+
+    if (Stats) {
+        cout << "\n" << Stats->summary(InARowGame(Grid, Base));
+        if (!Stats->save(options["stats"], InARowGame(Grid, Base))) {
+            cerr << "could not write " << options["stats"] << "\n";
+        }
+        Stats = nullptr;
+    }
     return 0;
-}
+#else
+    cerr << "-sessions needs a C++20 build (-std=c++20) for coroutines\n";
+    return 1;
+#endif
+} // sessions()
+
 
 int main(int argc, char *argv[]) {
     // wins, losses, draws
@@ -550,13 +859,13 @@ int main(int argc, char *argv[]) {
     double time_used = 0.0;
 
     // seed the random number generator
-    srand((unsigned) time(nullptr));
+    seed_random(uint64_t(time(nullptr)));
 
     int increment = 1000;
     
-    map<string, size_t> variations;
-    InARowGame board;
+    std::unordered_map<Position, size_t, Position::Hash> variations;
     int num_games = 0;
+    uint64_t saved = 0;     // open cells left when a game was drawn early
 
     int count = increment;
 
@@ -568,17 +877,232 @@ int main(int argc, char *argv[]) {
     Human = true;
 #endif
 
+#ifdef NOPONDER
+    Pondering = false;
+#endif
+
+#if defined(MOVETIME)
+    Clock.set_movetime(MOVETIME / 1000.0);
+#elif defined(GAMETIME) && defined(INCREMENT)
+    Clock.set_clock(GAMETIME / 1000.0, INCREMENT / 1000.0);
+#elif defined(GAMETIME)
+    Clock.set_clock(GAMETIME / 1000.0, 0.0);
+#elif defined(NODES)
+    Clock.set_nodes(NODES);
+#endif
+
 #ifdef DEBUG
     DbgLvl = 1;
 #endif
 
+    process_cmdline(argc, argv);
+
+    // the geometry for games that aren't given their own
+    if (options.count("grid")) {
+        Grid = atoi(options["grid"].c_str());
+    }
+    if (options.count("base")) {
+        Base = atoi(options["base"].c_str());
+    }
+    if (options.count("gravity")) {
+        Gravity = true;
+    }
+    if (options.count("dims")) {
+        Dims = atoi(options["dims"].c_str());
+    }
+    if (options.count("radius")) {
+        Radius = atoi(options["radius"].c_str());
+        if (Radius < 0) {
+            cerr << "invalid radius " << Radius << "\n";
+            return 1;
+        }
+    }
+    if (options.count("sparse")) {
+        // no board to fit in: only the number in a row matters
+        if (Base < 1 || Base > MaxLineBase) {
+            cerr << "invalid base " << Base << "\n";
+            return 1;
+        }
+        return sparse_games();
+    }
+    if (Grid < 1 || Base < 1 || Base > Grid || Base > MaxLineBase) {
+        cerr << "invalid geometry: grid " << Grid << " base " << Base << "\n";
+        return 1;
+    }
+    if (Dims < 2 || std::pow(double(Grid), Dims) > double(1 << 24)) {
+        cerr << "invalid geometry: grid " << Grid << " dims " << Dims << "\n";
+        return 1;
+    }
+    if (Dims > 2) {
+        // the modes below keep or send flat boards
+        for (char const *flat : { "gravity", "server", "perft", "enumerate", "export", "readexport" }) {
+            if (options.count(flat)) {
+                cerr << "-" << flat << " needs a flat board (-dims 2)\n";
+                return 1;
+            }
+        }
+    }
+
+    if (options.count("server")) {
+        // host games for other processes instead of playing them here
+        // engine searches run on their own workers, off the event loop
+        Server server(Clock, options.count("threads") ? size_t(atoi(options["threads"].c_str())) : 0);
+        if (!server.listen_on(options["server"])) {
+            return 1;
+        }
+        DbgLvl = 0;
+        cout << "serving games (default " << Grid << "x" << Grid << " / " << Base << ") on " << options["server"] << "\n";
+        cout.flush();
+        server.run();
+        return 0;
+    }
+
+    if (options.count("perft")) {
+        return perft();
+    }
+
+    if (options.count("enumerate")) {
+        return enumerate();
+    }
+
+    if (options.count("solve")) {
+        return solve();
+    }
+
+    // network evaluation weights for this geometry
+    std::shared_ptr<NnueWeights const> weights;
+    int const cells = InARowGame::cells(Grid, Dims);
+    int const lines = int(InARowGame(Grid, Base).m_lines.size());
+    if (options.count("weights")) {
+        weights = NnueWeights::load(options["weights"], cells, Base, lines);
+        if (weights == nullptr) {
+            cerr << "no " << Grid << "^" << Dims << " / " << Base << " weights in " << options["weights"] << "\n";
+            return 1;
+        }
+    }
+    if (options.count("makeweights")) {
+        if (!NnueWeights::handmade(cells, Base, lines)->save(options["makeweights"])) {
+            cerr << "could not write " << options["makeweights"] << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (options.count("verify")) {
+        return verify(weights ? weights : NnueWeights::handmade(cells, Base, lines));
+    }
+    if (options.count("nnuebench")) {
+        return nnue_bench(weights ? weights : NnueWeights::handmade(cells, Base, lines));
+    }
+
+    if (options.count("export")) {
+        return export_games();
+    }
+
+    if (options.count("readexport")) {
+        return read_export();
+    }
+
+    if (options.count("match")) {
+        return match();
+    }
+
+    if (options.count("sessions")) {
+        return sessions();
+    }
+
+    InARowGame board(Grid, Base);
+    board.m_nnue.attach(weights, board);
+
+    GameStats stats(board.m_cells, board.m_lines.size());
+    if (options.count("stats")) {
+        Stats = &stats;
+    }
+
+    std::unique_ptr<PhaseProfile> profile;
+    if (options.count("perf")) {
+        // nothing is printed while the games run so only the engine is measured
+        profile.reset(new PhaseProfile({ "think", "make_move", "analyze" }));
+        Profile = profile.get();
+        DbgLvl = 0;
+    }
+
+    Renderer screen(options.count("watch") ? atof(options["watch"].c_str()) : 0.0);
+    if (options.count("watch")) {
+        // the board is redrawn in place and nothing else is printed while the games run
+        Screen = &screen;
+        DbgLvl = 0;
+    }
+
+    // a journal of the run to -resume it from
+    std::unique_ptr<RunCheckpoint> journal;
+    if (options.count("checkpoint")) {
+        double const interval = options.count("interval") ? atof(options["interval"].c_str()) : 60.0;
+        journal.reset(new RunCheckpoint(board, options["checkpoint"], interval));
+
+        RunCheckpoint::State state;
+        bool const resumed = options.count("resume") && journal->load(state, variations);
+        if (resumed) {
+            for (int r=0; r < 3; ++r) {
+                results[r] = int(state.results[r]);
+            }
+            num_games = int(state.games);
+            count = int(state.count);
+            saved = state.saved;
+            time_used = state.seconds;
+            ThreadRng = Rng(state.rng);
+            if (Stats && !state.stats.empty() && !Stats->restore(state.stats)) {
+                cerr << "the -stats tables in " << journal->file() << " are for another board\n";
+            }
+            if (num_games > 0) {
+                DbgLvl = 0;
+            }
+            cout << "resuming from " << journal->file() << " at game " << commas(num_games) << "\n";
+        } else {
+            variations.clear();
+            if (options.count("resume") && journal->exists()) {
+                // don't write over a run of another board or other rules
+                cerr << journal->file() << " holds no run of this board and these rules to resume\n";
+                return 1;
+            }
+            if (options.count("resume")) {
+                cout << "no run to resume in " << journal->file() << "; starting a new one\n";
+            }
+        }
+        if (!journal->open(resumed)) {
+            cerr << "could not write checkpoint " << journal->file() << "\n";
+            return 1;
+        }
+        std::signal(SIGINT, [](int) { Interrupted = true; });
+    }
+
     {
     TimeUsed timer(time_used);
+    clock_t const began = clock();
+
+    // the run so far, as a journal record holds it
+    auto const snapshot = [&]() {
+        RunCheckpoint::State state;
+        state.games = uint64_t(num_games);
+        state.count = uint64_t(std::max(count, 0));
+        for (int r=0; r < 3; ++r) {
+            state.results[r] = uint64_t(results[r]);
+        }
+        state.saved = saved;
+        state.rng = ThreadRng.state;
+        state.seconds = time_used + double(clock() - began) / CLOCKS_PER_SEC;
+        if (Stats) {
+            state.stats = Stats->counts();
+        }
+        return state;
+    };
 
-    while (count--) {
+    while (!Interrupted && count--) {
         Move result = tictactoe(board);
         
         ++num_games;
+        if (Stats) {
+            Stats->record(board, result);
+        }
         
         switch (result.key) {
             default:        cout << "bug: game finished with " << result.to_string() << "\n"; board.display(); assert(false);
@@ -588,9 +1112,10 @@ int main(int argc, char *argv[]) {
             case ZERO:      cout << "bug: game finished with status of ZERO?\n";    break;
             case WINNER:
                 results[result.value - 1]++;
-                if (variations.find(board.state()) == variations.end()) {
-                    size_t table_size = variations.size();
-                    variations[board.state()] = table_size;
+                if (variations.emplace(board.state(), variations.size()).second) {
+                    if (journal) {
+                        journal->added(board.state(), variations.size() - 1);
+                    }
                     count = ((count / increment) + 1) * increment;
                     //cout << board.state() << " -> " << table_size << "    " << "\n" ;
                 }
@@ -598,6 +1123,7 @@ int main(int argc, char *argv[]) {
 
             case NOMOVE:
                 results[2]++;
+                saved += std::count(board.m_board.begin(), board.m_board.end(), 0);
 //                if (variations.find(board.state()) == variations.end()) {
 //                    size_t table_size = variations.size();
 //                    variations[board.state()] = table_size;
@@ -613,16 +1139,38 @@ int main(int argc, char *argv[]) {
 //            break;
 //        }
 
-        if (DbgLvl == 0 && count != 0 && count % 100 == 0)
+        if (Screen) {
+            Standings = "game " + commas(num_games) + "   X " + commas(results[1]) + "  O " + commas(results[0]) + "  draws " + commas(results[2]);
+            Screen->frame(board, Standings, count == 0);
+        } else if (DbgLvl == 0 && count != 0 && count % 100 == 0)
             cout << commas(count) << "\n";
         
         DbgLvl = 0;
         
         board.init_board();
+
+        if (journal && journal->due()) {
+            journal->post(snapshot());
+        }
+    }
+
+    if (journal) {
+        journal->post(snapshot());
     }
     }
 
+    if (journal && !journal->close()) {
+        cerr << "could not write checkpoint " << journal->file() << "\n";
+    }
+    if (Interrupted) {
+        cout << "\nstopped at game " << commas(num_games) << "; -resume to carry on\n";
+    }
+
     DbgLvl = 1;
+    if (Screen) {
+        Screen->finish();
+        Screen = nullptr;
+    }
 
     cout << "\n";
 
@@ -632,18 +1180,53 @@ int main(int argc, char *argv[]) {
 
     cout << "\n";
 
-    cout << "Grid Width: " << Grid << "\n";
+    cout << "Grid Width: " << board.m_grid << "\n";
+    if (board.m_dims > 2) {
+        cout << "Dimensions: " << board.m_dims << "\n";
+    }
+    cout << "In-A-Row: " << board.m_base << "\n";
     cout << "Total games: " << num_games << "\n";
-    cout << "Total spots: " << Grid * Grid << "\n";
+    cout << "Total spots: " << board.m_board.size() << "\n";
 
     char buff[128];
     sprintf(buff, "%g", time_used);
     cout << "Total time: " << buff << " seconds\n";
     sprintf(buff, "%g", time_used / num_games);
     cout << "Avg per game: " << buff << " seconds\n";
+    sprintf(buff, "%.0f", num_games / std::max(time_used, 1e-9));
+    cout << "Games/sec: " << buff << "\n";
 
     cout << variations.size() << " Variations\n";
 
+    if (results[2] > 0) {
+        sprintf(buff, "%.1f", double(saved) / results[2]);
+        cout << "Plies saved by early draws: " << commas(int(saved)) << " (" << buff << " per draw)\n";
+    }
+
+    if (Stats) {
+        cout << "\n" << Stats->summary(board);
+        if (!Stats->save(options["stats"], board)) {
+            cerr << "could not write " << options["stats"] << "\n";
+        }
+        Stats = nullptr;
+    }
+
+    if (Profile) {
+        cout << "\n" << Profile->report(Profile->phases()[PHASE_MOVE].calls);
+        Profile = nullptr;
+    }
+
+    if (options.count("watch")) {
+        cout << "Frames drawn: " << commas(int(screen.frames())) << " (" << commas(int(screen.skipped())) << " skipped by the frame rate cap)\n";
+    }
+
+    if (Clock.mode() != TimeControl::UNLIMITED) {
+        cout << "\n";
+        cout << "Timed moves: " << commas(int(Clock.moves())) << "\n";
+        sprintf(buff, "%g / %g / %g", Clock.percentile(50) * 1000, Clock.percentile(99) * 1000, Clock.percentile(100) * 1000);
+        cout << "Move latency p50 / p99 / max: " << buff << " ms\n";
+    }
+
     cout << "\n";
 
     if ((0)) {
@@ -651,13 +1234,13 @@ int main(int argc, char *argv[]) {
         int line = 0;
         bool do_disp = true;
         for (auto dv : variations) {
-            string const &contents = dv.first;
+            string const contents = dv.first.to_string(board.m_dispPieces);
             //size_t const &table_size = dv.second;
             cout << ++line << ") ";
             if (do_disp) {
                 cout << "\n";
                 for (int digit=0; digit < contents.size(); ++digit)
-                    cout << contents[digit] << ((digit+1) % Grid == 0 ? "\n" : " ");
+                    cout << contents[digit] << ((digit+1) % board.m_grid == 0 ? "\n" : " ");
             } else {
                 cout << contents << "\n";
             }
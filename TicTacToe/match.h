@@ -0,0 +1,295 @@
+///
+///  @file match.h
+///  @brief the declaration and definition of the EngineConfig, Sprt and Match classes
+///
+
+#ifndef match_h
+#define match_h
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include <iostream>
+using std::cout;
+
+#include <string>
+using std::string;
+
+#include "common.h"
+#include "move.h"
+#include "game.h"
+#include "nnue.h"
+#include "search.h"
+#include "threadpool.h"
+#include "timecontrol.h"
+
+/// @brief EngineConfig is one side of a Match: how it searches and what it sees.
+///
+/// A spec is a comma separated list of settings; an empty spec (or
+/// "one-ply") is the one-ply engine on every cell:
+///
+///     nodes=<n>       search <n> nodes per move
+///     movetime=<ms>   search <ms> milliseconds per move
+///     radius=<n>      consider only cells within <n> of a piece
+///     weights=<file>  evaluate searched positions with these network weights
+///
+struct EngineConfig {
+    string                              spec;
+    TimeControl                         clock;
+    int                                 radius = 0;
+    std::shared_ptr<NnueWeights const>  weights;
+
+    /// @name parse(string const &text, int const cells, int const base, int const lines, string &error)
+    /// @brief read a spec for a board of this geometry
+    /// @returns false with 'error' set if the spec is not understood
+    bool parse(string const &text, int const cells, int const base, int const lines, string &error) {
+        std::stringstream in(text);
+        string item;
+
+        spec = text.empty() ? "one-ply" : text;
+        while (std::getline(in, item, ',')) {
+            size_t const eq = item.find('=');
+            string const key = item.substr(0, eq);
+            string const value = (eq == string::npos) ? "" : item.substr(eq + 1);
+
+            if (key == "nodes" && atoll(value.c_str()) > 0) {
+                clock.set_nodes(uint64_t(atoll(value.c_str())));
+            } else if (key == "movetime" && atof(value.c_str()) > 0.0) {
+                clock.set_movetime(atof(value.c_str()) / 1000.0);
+            } else if (key == "radius" && atoi(value.c_str()) >= 0) {
+                radius = atoi(value.c_str());
+            } else if (key == "weights") {
+                weights = NnueWeights::load(value, cells, base, lines);
+                if (weights == nullptr) {
+                    error = "no weights for this board in " + value;
+                    return false;
+                }
+            } else if (!item.empty() && item != "one-ply") {
+                error = "unknown engine setting '" + item + "'";
+                return false;
+            }
+        }
+        return true;
+    } // EngineConfig::parse(...)
+};
+
+
+/// @brief Sprt runs a sequential probability ratio test on match results.
+///
+/// H0 is that the first engine is elo0 stronger than the second and H1
+/// that it is elo1 stronger. After each game the log likelihood ratio of
+/// the results is compared with the bounds set by alpha (the chance of
+/// accepting H1 when H0 holds) and beta (the reverse), so a match stops as
+/// soon as either hypothesis is accepted. The ratio uses the normal
+/// approximation of the generalized SPRT on wins, draws and losses: games
+/// start from the empty board, so there are no paired openings to count
+/// in pairs.
+///
+class Sprt {
+public:
+    typedef enum { CONTINUE, ACCEPT_H0, ACCEPT_H1 } status_e;
+
+private:
+    double      m_elo0;
+    double      m_elo1;
+    double      m_lower;        // accept H0 at or below this
+    double      m_upper;        // accept H1 at or above this
+    uint64_t    m_results[3];   // wins, draws, losses of the first engine
+
+    static double expected(double const elo) {
+        return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+    }
+
+    static double elo(double const score) {
+        double const s = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+        return 400.0 * std::log10(s / (1.0 - s));
+    }
+
+    /// @brief the first engine's mean score and the variance of one game's
+    /// score, with 'prior' extra wins and losses
+    void moments(double const prior, double &mean, double &variance) const {
+        double const wins = m_results[0] + prior;
+        double const losses = m_results[2] + prior;
+        double const n = wins + m_results[1] + losses;
+        mean = (wins + 0.5 * m_results[1]) / n;
+        variance = (wins * (1.0 - mean) * (1.0 - mean)
+                  + m_results[1] * (0.5 - mean) * (0.5 - mean)
+                  + losses * mean * mean) / n;
+    }
+
+public:
+    Sprt(double const elo0 = 0.0, double const elo1 = 10.0, double const alpha = 0.05, double const beta = 0.05) :
+        m_elo0(elo0),
+        m_elo1(elo1),
+        m_lower(std::log(beta / (1.0 - alpha))),
+        m_upper(std::log((1.0 - beta) / alpha)),
+        m_results { 0, 0, 0 } {
+    } // Sprt::Sprt(...)
+
+
+    /// @brief count a game: 1 a win for the first engine, 0 a draw, -1 a loss
+    void add(int const result) {
+        m_results[1 - result]++;
+    }
+
+    uint64_t games() const { return m_results[0] + m_results[1] + m_results[2]; }
+    uint64_t wins() const { return m_results[0]; }
+    uint64_t draws() const { return m_results[1]; }
+    uint64_t losses() const { return m_results[2]; }
+    double lower() const { return m_lower; }
+    double upper() const { return m_upper; }
+
+
+    /// @returns the log likelihood ratio of H1 to H0
+    double llr() const {
+        if (games() == 0) {
+            return 0.0;
+        }
+        // half a win and half a loss keep the variance above zero while
+        // every game has gone the same way (a run of draws is evidence too)
+        double mean, variance;
+        moments(0.5, mean, variance);
+        double const s0 = expected(m_elo0);
+        double const s1 = expected(m_elo1);
+        return games() * (s1 - s0) * (2.0 * mean - s0 - s1) / (2.0 * variance);
+    } // Sprt::llr()
+
+
+    status_e status() const {
+        double const ratio = llr();
+        return ratio >= m_upper ? ACCEPT_H1 : ratio <= m_lower ? ACCEPT_H0 : CONTINUE;
+    }
+
+
+    /// @name elo(double &low, double &high) const
+    /// @returns the first engine's Elo advantage; 'low' and 'high' bound its 95% confidence interval
+    double elo(double &low, double &high) const {
+        if (games() == 0) {
+            low = high = 0.0;
+            return 0.0;
+        }
+        double mean, variance;
+        moments(0.0, mean, variance);
+        double const margin = 1.959964 * std::sqrt(variance / games());
+        low = elo(mean - margin);
+        high = elo(mean + margin);
+        return elo(mean);
+    } // Sprt::elo(double &low, double &high)
+
+};  // class Sprt
+
+
+/// @brief Match plays two EngineConfigs against each other until the Sprt
+/// decides or the game limit is reached.
+///
+/// Game g has the first engine playing X (moving first) when g is even, so
+/// the colors alternate. Games are tasks on a WorkStealingPool, each on its
+/// own InARowGame with a Searcher per engine, and only the tally is shared.
+/// Before each move the game takes on the mover's radius and network.
+/// Once the test is decided the games not yet started are dropped and the
+/// ones already running are finished and counted.
+///
+class Match {
+private:
+    EngineConfig const     *m_engines[2];
+    Sprt                    m_sprt;
+    std::mutex              m_lock;         // guards m_sprt and m_colors
+    std::atomic<bool>       m_decided;
+    uint64_t                m_colors[2][3]; // the first engine's wins, draws, losses as X and as O
+    uint64_t                m_report;       // print the standings every m_report games (0: never)
+
+    /// @name play(uint64_t const g)
+    /// @returns 1 if the first engine won game g, 0 for a draw, -1 for a loss
+    int play(uint64_t const g) const {
+        InARowGame board(Grid, Base);
+        TimeControl clocks[2] { m_engines[0]->clock, m_engines[1]->clock };
+        Searcher searchers[2] { Searcher(clocks[0]), Searcher(clocks[1]) };
+        int const x = int(g & 1);           // the engine playing X
+        int const spots = int(board.m_board.size());
+        Move result;
+
+        clocks[0].new_game();
+        clocks[1].new_game();
+        for (int turn=1; turn <= spots; ++turn) {
+            int const side = turn & 1;      // 1 moves X
+            EngineConfig const &engine = *m_engines[side ? x : 1 - x];
+
+            board.set_radius(engine.radius);
+            if (board.m_nnue.weights() != engine.weights) {
+                board.m_nnue.attach(engine.weights, board);
+            }
+            Move const move = searchers[side ? x : 1 - x].think(board, side);
+            result = board.process(side, move);
+            if (result.key == NOMOVE || result.key == WINNER) {
+                break;
+            }
+        }
+
+        if (result.key != WINNER) {
+            return 0;
+        }
+        // X is piece 2
+        return ((result.value == 2) == (x == 0)) ? 1 : -1;
+    } // Match::play(uint64_t const g)
+
+
+    void record(uint64_t const g, int const result) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_sprt.add(result);
+        m_colors[g & 1][1 - result]++;
+        if (m_sprt.status() != Sprt::CONTINUE) {
+            m_decided = true;
+        }
+        if (m_report && m_sprt.games() % m_report == 0) {
+            char buff[128];
+            sprintf(buff, "games %llu: +%llu =%llu -%llu  LLR %.2f (%.2f, %.2f)\n",
+                    (unsigned long long) m_sprt.games(), (unsigned long long) m_sprt.wins(),
+                    (unsigned long long) m_sprt.draws(), (unsigned long long) m_sprt.losses(),
+                    m_sprt.llr(), m_sprt.lower(), m_sprt.upper());
+            cout << buff;
+            cout.flush();
+        }
+    } // Match::record(uint64_t const g, int const result)
+
+public:
+    Match(EngineConfig const &first, EngineConfig const &second, Sprt const &sprt, uint64_t const report = 0) :
+        m_engines { &first, &second },
+        m_sprt(sprt),
+        m_decided(false),
+        m_colors {},
+        m_report(report) {
+    } // Match::Match(...)
+
+
+    Sprt const &sprt() const { return m_sprt; }
+
+    /// @returns the first engine's wins (0), draws (1) or losses (2) playing X when 'x', else O
+    uint64_t colored(bool const x, int const outcome) const { return m_colors[x ? 0 : 1][outcome]; }
+
+
+    /// @name run(uint64_t const games, size_t const threads)
+    /// @brief play up to 'games' games on 'threads' workers (0: one per core)
+    /// @returns the Sprt's verdict
+    Sprt::status_e run(uint64_t const games, size_t const threads = 0) {
+        {
+            WorkStealingPool pool(threads);
+            for (uint64_t g=0; g < games; ++g) {
+                pool.submit([this, g] {
+                    if (!m_decided.load()) {
+                        record(g, play(g));
+                    }
+                });
+            }
+        }
+        return m_sprt.status();
+    } // Match::run(uint64_t const games, size_t const threads)
+
+};  // class Match
+
+#endif /* match_h */
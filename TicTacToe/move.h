@@ -46,11 +46,12 @@ struct Move {
     int         value;
     vector<int> choices;
 
-    /// @name to_string(int const flag=1) const
+    /// @name to_string(int const flag=1, int const grid=Grid) const
     /// @brief return a human readable string for this Move
     /// @param flag if set to 0 then suppress the human readable Move choices
+    /// @param grid the width of the board the Move is for
     /// @returns this Move as a human readable string
-    string to_string(int const flag=1) const {
+    string to_string(int const flag=1, int const grid=Grid) const {
         string key_str, value_str, choices_str;
 
         if (flag > 0) {
@@ -66,7 +67,7 @@ struct Move {
             key == RANDOM2 ? "RANDOM2" :
             key == WINNER  ? "WINNER " : itoa(key, 10, 7);
 
-        value_str = " value: " + (UseCoords ? coords(value, Grid) + " (" + itoa(value) + ")" : itoa(value));
+        value_str = " value: " + (UseCoords ? coords(value, grid) + " (" + itoa(value) + ")" : itoa(value));
         
         string result = key_str + value_str + choices_str + " }";
 
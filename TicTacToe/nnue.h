@@ -0,0 +1,287 @@
+///
+///  @file nnue.h
+///  @brief the declaration and definition of the NnueWeights and NnueAccumulator classes
+///
+
+#ifndef nnue_h
+#define nnue_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "common.h"
+#include "line.h"
+
+/// @brief NnueWeights holds a small quantized network for one board geometry.
+///
+/// The input features are sparse and binary:
+///
+///     - one per cell and piece: cell * 2 + piece - 1
+///     - one per Line, owner and count for every Line holding pieces of one
+///       side only: cells * 2 + (line * 2 + owner - 1) * base + count - 1
+///
+/// The first layer maps the active features onto Hidden int16 sums, the
+/// accumulator. The output is the dot product of the ReLU of the
+/// accumulator with the int16 output weights plus an int32 bias, and is
+/// the score for 'X'.
+///
+class NnueWeights {
+public:
+    static int constexpr Hidden = 32;
+
+    int const       m_cells;
+    int const       m_base;
+    int const       m_lines;
+    int const       m_features;
+    vector<int16_t> m_input;        // [feature][Hidden]
+    int16_t         m_bias[Hidden];
+    int16_t         m_output[Hidden];
+    int32_t         m_output_bias;
+
+    NnueWeights(int const cells, int const base, int const lines) :
+        m_cells(cells),
+        m_base(base),
+        m_lines(lines),
+        m_features(cells * 2 + lines * 2 * base),
+        m_input(size_t(m_features) * Hidden, 0),
+        m_bias {},
+        m_output {},
+        m_output_bias(0) {
+    } // NnueWeights::NnueWeights(...)
+
+
+    inline int cell_feature(int const cell, int const piece) const {
+        return cell * 2 + piece - 1;
+    }
+
+    inline int line_feature(int const line, int const owner, int const count) const {
+        return m_cells * 2 + (line * 2 + owner - 1) * m_base + count - 1;
+    }
+
+    inline int16_t const *row(int const feature) const {
+        return &m_input[size_t(feature) * Hidden];
+    }
+
+
+    /// @name handmade(int const cells, int const base, int const lines)
+    /// @brief weights that reproduce Searcher's hand written evaluation:
+    /// hidden unit 0 adds count^3 for each of 'X's Lines, unit 1 the same
+    /// for 'O', and the output is unit 0 less unit 1
+    static std::shared_ptr<NnueWeights> handmade(int const cells, int const base, int const lines) {
+        std::shared_ptr<NnueWeights> w = std::make_shared<NnueWeights>(cells, base, lines);
+        for (int line=0; line < lines; ++line) {
+            for (int owner=1; owner <= 2; ++owner) {
+                for (int count=1; count <= base; ++count) {
+                    int16_t *r = &w->m_input[size_t(w->line_feature(line, owner, count)) * Hidden];
+                    r[owner == 2 ? 0 : 1] = int16_t(std::min(count * count * count, 1000));
+                }
+            }
+        }
+        w->m_output[0] = 1;
+        w->m_output[1] = -1;
+        return w;
+    } // NnueWeights::handmade(...)
+
+
+    /// @name save(string const &file) const
+    /// @returns true on success
+    bool save(string const &file) const {
+        FILE *fp = fopen(file.c_str(), "wb");
+        if (fp == nullptr) {
+            return false;
+        }
+        int32_t const head[5] { 0x45554e4e, m_cells, m_base, m_lines, Hidden };
+        bool ok = fwrite(head, sizeof(head), 1, fp) == 1
+               && fwrite(m_input.data(), sizeof(int16_t), m_input.size(), fp) == m_input.size()
+               && fwrite(m_bias, sizeof(m_bias), 1, fp) == 1
+               && fwrite(m_output, sizeof(m_output), 1, fp) == 1
+               && fwrite(&m_output_bias, sizeof(m_output_bias), 1, fp) == 1;
+        return (fclose(fp) == 0) && ok;
+    } // NnueWeights::save(string const &file)
+
+
+    /// @name load(string const &file, int const cells, int const base, int const lines)
+    /// @returns the weights, or nullptr if the file is missing, damaged, or
+    ///          made for another geometry
+    static std::shared_ptr<NnueWeights> load(string const &file, int const cells, int const base, int const lines) {
+        FILE *fp = fopen(file.c_str(), "rb");
+        if (fp == nullptr) {
+            return nullptr;
+        }
+        std::shared_ptr<NnueWeights> w = std::make_shared<NnueWeights>(cells, base, lines);
+        int32_t head[5] {};
+        bool ok = fread(head, sizeof(head), 1, fp) == 1
+               && head[0] == 0x45554e4e && head[1] == cells && head[2] == base && head[3] == lines && head[4] == Hidden
+               && fread(w->m_input.data(), sizeof(int16_t), w->m_input.size(), fp) == w->m_input.size()
+               && fread(w->m_bias, sizeof(w->m_bias), 1, fp) == 1
+               && fread(w->m_output, sizeof(w->m_output), 1, fp) == 1
+               && fread(&w->m_output_bias, sizeof(w->m_output_bias), 1, fp) == 1;
+        fclose(fp);
+        return ok ? w : nullptr;
+    } // NnueWeights::load(...)
+
+};  // class NnueWeights
+
+
+/// @brief NnueAccumulator keeps the first layer sums of a game's position.
+///
+/// A move only changes the features of its cell and of the Lines through
+/// it, so InARowGame calls leave() before and enter() after it changes a
+/// cell and the accumulator subtracts the old features and adds the new
+/// ones. With AVX2 each feature is two 256 bit adds or subtracts; other
+/// builds use a plain loop. Without weights the accumulator is inactive
+/// and costs one test per move.
+///
+class NnueAccumulator {
+public:
+    static int constexpr Hidden = NnueWeights::Hidden;
+
+private:
+    std::shared_ptr<NnueWeights const>  m_weights;
+    alignas(32) int16_t                 m_acc[Hidden];
+
+    inline void add(int const feature) {
+        int16_t const *w = m_weights->row(feature);
+#if defined(__AVX2__)
+        for (int i=0; i < Hidden; i += 16) {
+            __m256i *a = reinterpret_cast<__m256i *>(&m_acc[i]);
+            _mm256_store_si256(a, _mm256_add_epi16(_mm256_load_si256(a), _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&w[i]))));
+        }
+#else
+        for (int i=0; i < Hidden; ++i) {
+            m_acc[i] = int16_t(m_acc[i] + w[i]);
+        }
+#endif
+    } // NnueAccumulator::add(int const feature)
+
+
+    inline void sub(int const feature) {
+        int16_t const *w = m_weights->row(feature);
+#if defined(__AVX2__)
+        for (int i=0; i < Hidden; i += 16) {
+            __m256i *a = reinterpret_cast<__m256i *>(&m_acc[i]);
+            _mm256_store_si256(a, _mm256_sub_epi16(_mm256_load_si256(a), _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&w[i]))));
+        }
+#else
+        for (int i=0; i < Hidden; ++i) {
+            m_acc[i] = int16_t(m_acc[i] - w[i]);
+        }
+#endif
+    } // NnueAccumulator::sub(int const feature)
+
+
+    /// @returns the feature of a Line in its current state, or -1 if it has none
+    inline int line_feature(Line const &line, int const index) const {
+        Pattern const p = line.pattern();
+        if (p.owner == 0) {
+            return -1;
+        }
+        return m_weights->line_feature(index, p.owner, line.m_length - p.empties);
+    }
+
+
+    /// @name touch(Game const &game, int const cell, bool const adding)
+    /// @brief add or subtract every feature that depends on 'cell'
+    template<typename Game>
+    inline void touch(Game const &game, int const cell, bool const adding) {
+        int const piece = game.m_board[cell];
+        if (piece != 0) {
+            int const f = m_weights->cell_feature(cell, piece);
+            adding ? add(f) : sub(f);
+        }
+        for (auto const &entry : game.cell_lines(cell)) {
+            int const f = line_feature(game.m_lines[entry.first], entry.first);
+            if (f >= 0) {
+                adding ? add(f) : sub(f);
+            }
+        }
+    } // NnueAccumulator::touch(...)
+
+
+public:
+    NnueAccumulator() : m_acc {} {}
+
+    bool active() const { return m_weights != nullptr; }
+    std::shared_ptr<NnueWeights const> const &weights() const { return m_weights; }
+
+
+    /// @name attach(std::shared_ptr<NnueWeights const> weights, Game const &game)
+    /// @brief evaluate 'game' with these weights from now on (nullptr to stop)
+    template<typename Game>
+    void attach(std::shared_ptr<NnueWeights const> weights, Game const &game) {
+        m_weights = weights;
+        if (active()) {
+            refresh(game);
+        }
+    } // NnueAccumulator::attach(...)
+
+
+    /// @name refresh(Game const &game)
+    /// @brief recompute the accumulator from scratch
+    template<typename Game>
+    void refresh(Game const &game) {
+        std::copy(m_weights->m_bias, m_weights->m_bias + Hidden, m_acc);
+        for (int cell=0; cell < int(game.m_board.size()); ++cell) {
+            if (game.m_board[cell] != 0) {
+                add(m_weights->cell_feature(cell, game.m_board[cell]));
+            }
+        }
+        for (int i=0; i < int(game.m_lines.size()); ++i) {
+            int const f = line_feature(game.m_lines[i], i);
+            if (f >= 0) {
+                add(f);
+            }
+        }
+    } // NnueAccumulator::refresh(Game const &game)
+
+
+    /// @brief call before a cell changes
+    template<typename Game>
+    inline void leave(Game const &game, int const cell) { touch(game, cell, false); }
+
+    /// @brief call after a cell changed
+    template<typename Game>
+    inline void enter(Game const &game, int const cell) { touch(game, cell, true); }
+
+
+    /// @name evaluate() const
+    /// @returns the network's score for 'X'
+    int evaluate() const {
+        int16_t const *out = m_weights->m_output;
+#if defined(__AVX2__)
+        __m256i sum = _mm256_setzero_si256();
+        __m256i const zero = _mm256_setzero_si256();
+        for (int i=0; i < Hidden; i += 16) {
+            __m256i const a = _mm256_max_epi16(_mm256_load_si256(reinterpret_cast<__m256i const *>(&m_acc[i])), zero);
+            __m256i const w = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(&out[i]));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+        return _mm_cvtsi128_si32(s) + m_weights->m_output_bias;
+#else
+        int32_t sum = m_weights->m_output_bias;
+        for (int i=0; i < Hidden; ++i) {
+            sum += int32_t(std::max<int16_t>(m_acc[i], 0)) * out[i];
+        }
+        return sum;
+#endif
+    } // NnueAccumulator::evaluate()
+
+};  // class NnueAccumulator
+
+#endif /* nnue_h */
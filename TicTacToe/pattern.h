@@ -0,0 +1,172 @@
+///
+///  @file pattern.h
+///  @brief precomputed Line pattern tables indexed by the base-3 line encoding
+///
+
+#ifndef pattern_h
+#define pattern_h
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+
+/// @brief A Line window of 'Base' cells is encoded as a base-3 number where
+/// cell i of the Line contributes (piece * 3^i) and piece is 0, 1, or 2.
+/// Placing a piece on cell i of a Line is then a single add to its code.
+///
+/// The largest Base that still gets a lookup table. Anything longer is
+/// classified on the fly from its code.
+static int constexpr MaxPatternBase = 12;
+
+/// The largest Base whose code fits in the 32-bit Line encoding
+static int constexpr MaxLineBase = 20;
+
+static constexpr std::array<uint32_t, MaxLineBase + 1> Pow3 = [] {
+    std::array<uint32_t, MaxLineBase + 1> pow {};
+    uint32_t value = 1;
+    for (int i=0; i <= MaxLineBase; ++i, value *= 3) {
+        pow[i] = value;
+    }
+    return pow;
+}();
+
+
+/// @brief Pattern is the precomputed classification of one Line encoding.
+///
+/// The key follows the Move ranking in move.h with one exception: a Line
+/// holding both players and at least one open cell is stored as RANDOM2.
+/// Whether that is ranked RANDOM1 instead depends on the board width and
+/// is decided by resolve() at lookup time.
+///
+struct Pattern {
+    movetype_e  key     = ZERO; // the Line status
+    uint8_t     owner   = 0;    // piece (1 or 2) owning a WINNER or FORCED Line, else 0
+    uint8_t     empties = 0;    // number of open cells in the Line
+    uint16_t    open    = 0;    // bit i is set when cell i of the Line is open
+
+    /// @name resolve(int const grid, int const base) const
+    /// @brief rank this pattern for a board of the given width
+    /// @returns the movetype_e for this pattern on that board
+    constexpr movetype_e resolve(int const grid, int const base) const {
+        if (key == RANDOM2 && grid - empties >= base) {
+            return RANDOM1;
+        }
+        return key;
+    } // Pattern::resolve(int const grid, int const base)
+
+
+    /// @name first() const
+    /// @returns the position within the Line of the first open cell or -1
+    constexpr int first() const {
+        for (int i=0; i < 16; ++i) {
+            if (open & (1 << i)) return i;
+        }
+        return -1;
+    } // Pattern::first()
+
+};  // struct Pattern
+
+
+/// @name classify(uint32_t code, int const base)
+/// @brief the reference classification every table entry is generated from
+/// @param code the base-3 encoding of the Line's cells
+/// @param base the number of cells in the Line
+/// @returns the Pattern for that Line encoding
+static constexpr Pattern classify(uint32_t code, int const base) {
+    int num[3] {};
+    uint16_t open = 0;
+
+    for (int i=0; i < base; ++i, code /= 3) {
+        int const piece = code % 3;
+        num[piece]++;
+        if (piece == 0 && i < 16) open |= uint16_t(1 << i);
+    }
+
+    Pattern result;
+    result.empties = uint8_t(num[0]);
+    result.open = open;
+
+    if (num[1] && num[2]) {
+        // this line involves both players; it can never be won
+        result.key = num[0] ? RANDOM2 : NOMOVE;
+        result.open = num[0] ? open : 0;
+        return result;
+    }
+
+    result.owner = uint8_t(num[1] ? 1 : num[2] ? 2 : 0);
+    if (result.owner == 0 || num[0] > 1) {
+        // all open, or one side's pieces and more than one open cell
+        result.key = RANDOM1;
+    } else if (num[0] == 1) {
+        // one open cell that would complete the line
+        result.key = FORCED;
+    } else {
+        // all cells have the same value; the game has been won
+        result.key = WINNER;
+    }
+
+    return result;
+} // classify(uint32_t code, int const base)
+
+
+/// @brief A table holding the Pattern for every encoding of a Line of length B.
+/// Instantiated as constexpr below so the common sizes are generated at build time.
+template <int B>
+struct PatternTable {
+    static int constexpr size = int(Pow3[B]);
+    std::array<Pattern, size> entries {};
+
+    constexpr PatternTable() {
+        for (int code=0; code < size; ++code) {
+            entries[code] = classify(code, B);
+        }
+    }
+};  // struct PatternTable
+
+// Tic-Tac-Toe, Connect-Four, Gomoku, and the default 7 in a row
+static constexpr PatternTable<3> Patterns3 {};
+static constexpr PatternTable<4> Patterns4 {};
+static constexpr PatternTable<5> Patterns5 {};
+static constexpr PatternTable<6> Patterns6 {};
+static constexpr PatternTable<7> Patterns7 {};
+
+
+/// @name pattern_table(int const base)
+/// @brief get the lookup table for Lines of the given length.
+/// Uncommon lengths up to MaxPatternBase are generated on first use.
+/// @returns the table indexed by Line code, or nullptr if 'base' is too long to tabulate
+inline Pattern const *pattern_table(int const base) {
+    switch (base) {
+        case 3: return Patterns3.entries.data();
+        case 4: return Patterns4.entries.data();
+        case 5: return Patterns5.entries.data();
+        case 6: return Patterns6.entries.data();
+        case 7: return Patterns7.entries.data();
+        default: break;
+    }
+
+    if (base < 1 || base > MaxPatternBase) {
+        return nullptr;
+    }
+
+    static vector<Pattern> tables[MaxPatternBase + 1];
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+
+    vector<Pattern> &table = tables[base];
+    if (table.empty()) {
+        table.resize(Pow3[base]);
+        for (uint32_t code=0; code < Pow3[base]; ++code) {
+            table[code] = classify(code, base);
+        }
+    }
+
+    return table.data();
+} // pattern_table(int const base)
+
+#endif /* pattern_h */
@@ -0,0 +1,263 @@
+///
+///  @file perfcounters.h
+///  @brief the declaration and definition of the PerfCounters and PhaseProfile classes
+///
+
+#ifndef perfcounters_h
+#define perfcounters_h
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// @brief PerfCounters reads the CPU's hardware event counters for this
+/// thread through Linux perf_event_open.
+///
+/// The four events are opened as one group so they are always read
+/// together with a single read(). Only user space is counted. When the
+/// counters can't be opened (another OS, a virtual machine without a PMU,
+/// or perf_event_paranoid forbidding it) available() is false, why()
+/// says why, and read() returns zeros. An event the CPU lacks is left out
+/// of the group and reads as zero while the others still count.
+///
+class PerfCounters {
+public:
+    enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, EVENTS };
+
+    struct Sample {
+        uint64_t    counts[EVENTS] {};
+    };
+
+private:
+    int         m_fds[EVENTS];
+    int         m_slot[EVENTS];     // each event's place in a group read, or -1 if it isn't counted
+    int         m_opened;
+    string      m_why;
+
+public:
+    PerfCounters() : m_opened(0), m_why("not opened") {
+        for (int e=0; e < EVENTS; ++e) {
+            m_fds[e] = -1;
+            m_slot[e] = -1;
+        }
+    } // PerfCounters::PerfCounters()
+
+
+    ~PerfCounters() {
+        close();
+    }
+
+
+    PerfCounters(PerfCounters const &) = delete;
+    PerfCounters &operator = (PerfCounters const &) = delete;
+
+
+    bool available() const { return m_opened > 0; }
+    bool counts(int const event) const { return m_slot[event] >= 0; }
+    string const &why() const { return m_why; }
+
+
+    /// @name open()
+    /// @brief start counting on the calling thread
+    /// @returns false if no hardware counter could be opened
+    bool open() {
+        close();
+#ifdef __linux__
+        static uint64_t constexpr configs[EVENTS] {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        for (int e=0; e < EVENTS; ++e) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[e];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = (m_opened == 0);
+
+            int const leader = m_opened ? m_fds[CYCLES] : -1;
+            int const fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                if (e == CYCLES) {
+                    // no group to join: nothing can be counted
+                    m_why = string("perf_event_open: ") + strerror(errno);
+                    return false;
+                }
+                continue;
+            }
+            m_fds[e] = fd;
+            m_slot[e] = m_opened++;
+        }
+
+        ioctl(m_fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        m_why.clear();
+        return true;
+#else
+        m_why = "hardware counters need Linux perf_event_open";
+        return false;
+#endif
+    } // PerfCounters::open()
+
+
+    void close() {
+#ifdef __linux__
+        for (int e=EVENTS; e-- > 0; ) {
+            if (m_fds[e] >= 0) {
+                ::close(m_fds[e]);
+            }
+        }
+#endif
+        for (int e=0; e < EVENTS; ++e) {
+            m_fds[e] = -1;
+            m_slot[e] = -1;
+        }
+        m_opened = 0;
+    } // PerfCounters::close()
+
+
+    /// @returns the counts so far, or zeros when nothing is counted
+    Sample read() const {
+        Sample s;
+#ifdef __linux__
+        if (m_opened > 0) {
+            uint64_t buff[1 + EVENTS] {};      // { number of events, value, value, ... }
+            if (::read(m_fds[CYCLES], buff, sizeof(buff)) > 0) {
+                for (int e=0; e < EVENTS; ++e) {
+                    if (m_slot[e] >= 0) {
+                        s.counts[e] = buff[1 + m_slot[e]];
+                    }
+                }
+            }
+        }
+#endif
+        return s;
+    } // PerfCounters::read()
+
+};  // class PerfCounters
+
+
+/// @brief PhaseProfile charges time and hardware counts to the phases of
+/// a run.
+///
+/// charge(phase) gives everything counted since the last charge() (or
+/// start()) to 'phase', so calling it at the end of each phase splits the
+/// run between them. The wall clock is always measured; the hardware
+/// counts only when PerfCounters are available.
+///
+class PhaseProfile {
+public:
+    struct Phase {
+        string      name;
+        uint64_t    calls = 0;
+        double      seconds = 0.0;
+        uint64_t    counts[PerfCounters::EVENTS] {};
+    };
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    PerfCounters            m_counters;
+    vector<Phase>           m_phases;
+    PerfCounters::Sample    m_last;
+    clock::time_point       m_last_time;
+
+public:
+    explicit PhaseProfile(vector<string> const &names) {
+        for (string const &name : names) {
+            m_phases.emplace_back();
+            m_phases.back().name = name;
+        }
+        m_counters.open();
+        start();
+    } // PhaseProfile::PhaseProfile(vector<string> const &names)
+
+
+    PerfCounters const &counters() const { return m_counters; }
+    vector<Phase> const &phases() const { return m_phases; }
+
+
+    /// @brief start the next phase without charging the time since the last one
+    void start() {
+        m_last = m_counters.read();
+        m_last_time = clock::now();
+    }
+
+
+    /// @name charge(int const phase)
+    /// @brief give everything since the last charge() or start() to 'phase'
+    inline void charge(int const phase) {
+        PerfCounters::Sample const now = m_counters.read();
+        clock::time_point const now_time = clock::now();
+        Phase &p = m_phases[phase];
+
+        p.calls++;
+        p.seconds += std::chrono::duration<double>(now_time - m_last_time).count();
+        for (int e=0; e < PerfCounters::EVENTS; ++e) {
+            p.counts[e] += now.counts[e] - m_last.counts[e];
+        }
+        m_last = now;
+        m_last_time = now_time;
+    } // PhaseProfile::charge(int const phase)
+
+
+    /// @name report(uint64_t const plies) const
+    /// @returns a table of each phase's time and counts per ply and its IPC
+    string report(uint64_t const plies) const {
+        string out;
+        char buff[160];
+        double const n = double(plies ? plies : 1);
+
+        sprintf(buff, "%-12s %10s %12s %12s %6s %14s %14s\n",
+                "Phase", "ns/ply", "cycles/ply", "instr/ply", "IPC", "cache miss/ply", "branch miss/ply");
+        out += buff;
+        for (Phase const &p : m_phases) {
+            if (!m_counters.available()) {
+                sprintf(buff, "%-12s %10.1f %12s %12s %6s %14s %14s\n", p.name.c_str(), p.seconds * 1e9 / n, "-", "-", "-", "-", "-");
+                out += buff;
+                continue;
+            }
+            // an event the CPU doesn't count shows as '-'
+            string cells[PerfCounters::EVENTS + 1];
+            for (int e=0; e < PerfCounters::EVENTS; ++e) {
+                sprintf(buff, e < PerfCounters::CACHE_MISSES ? "%.0f" : "%.2f", p.counts[e] / n);
+                cells[e] = m_counters.counts(e) ? buff : "-";
+            }
+            sprintf(buff, "%.2f", double(p.counts[PerfCounters::INSTRUCTIONS]) / std::max<uint64_t>(p.counts[PerfCounters::CYCLES], 1));
+            cells[PerfCounters::EVENTS] = m_counters.counts(PerfCounters::INSTRUCTIONS) ? buff : "-";
+            sprintf(buff, "%-12s %10.1f %12s %12s %6s %14s %14s\n", p.name.c_str(), p.seconds * 1e9 / n,
+                    cells[PerfCounters::CYCLES].c_str(), cells[PerfCounters::INSTRUCTIONS].c_str(), cells[PerfCounters::EVENTS].c_str(),
+                    cells[PerfCounters::CACHE_MISSES].c_str(), cells[PerfCounters::BRANCH_MISSES].c_str());
+            out += buff;
+        }
+        if (!m_counters.available()) {
+            out += "hardware counters unavailable (" + m_counters.why() + "); times only\n";
+        }
+        return out;
+    } // PhaseProfile::report(uint64_t const plies)
+
+};  // class PhaseProfile
+
+#endif /* perfcounters_h */
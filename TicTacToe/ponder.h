@@ -0,0 +1,194 @@
+///
+///  @file ponder.h
+///  @brief the declaration and definition of the Ponderer class
+///
+
+#ifndef ponder_h
+#define ponder_h
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <map>
+using std::map;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "move.h"
+#include "game.h"
+#include "search.h"
+
+/// @brief Ponderer thinks on the human's time.
+///
+/// While human_move() blocks waiting for input, a background thread works
+/// through the human's likely replies, making and taking back each one on a
+/// private copy of the game, and
+/// caches the engine's answer to each one. When the human plays a reply that
+/// was pondered the engine answers from the cache without thinking again.
+///
+/// The human's likely replies are pondered first: the cells the engine would
+/// choose if it were moving for the human, then every other playable cell
+/// (in a gravity game, one for each column that isn't full).
+///
+class Ponderer {
+private:
+    Searcher                   *m_engine;   // the engine whose answers are pondered
+    std::unique_ptr<InARowGame> m_game;     // private copy of the position being pondered
+    map<int, Move>              m_cache;    // human reply -> engine answer
+    std::mutex                  m_lock;     // guards m_cache
+    std::atomic<bool>           m_stop;     // set to cancel the background search
+    std::thread                 m_thread;
+    int                         m_hits;
+    int                         m_misses;
+
+    /// @name run(int const human)
+    /// @brief the background thread: answer each likely reply until stopped
+    void run(int const human) {
+        Searcher engine(m_engine->clock());
+        int const turn = (human == 2) ? 0 : 1;
+        vector<int> replies;
+
+        // the cells the engine would pick for the human go first
+        Move const likely = m_game->score();
+        if (likely.key == FORCED && m_game->playable(likely.value)) {
+            replies.push_back(likely.value);
+        }
+        for (int const c : likely.choices) {
+            if (m_game->playable(c)) {
+                replies.push_back(c);
+            }
+        }
+        if (m_game->m_gravity) {
+            // one reply per column: the cell a piece dropped there lands on
+            for (int column=0; column < m_game->m_grid; ++column) {
+                int const cell = m_game->drop(column);
+                if (cell >= 0) {
+                    replies.push_back(cell);
+                }
+            }
+        } else {
+            for (int n=0; n < int(m_game->m_board.size()); ++n) {
+                if (m_game->playable(n)) {
+                    replies.push_back(n);
+                }
+            }
+        }
+
+        for (int const reply : replies) {
+            if (m_stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                if (m_cache.count(reply)) {
+                    continue;
+                }
+            }
+
+            InARowGame &game = *m_game;
+            game.place(reply, human);
+
+            // a reply that ends the game leaves nothing to answer
+            Move const status = game.score();
+            Move answer;
+            bool const answered = status.key != WINNER && status.key != NOMOVE;
+            if (answered) {
+                answer = engine.ponder(game, turn, &m_stop);
+            }
+            game.unplace(reply);
+
+            // an answer cut short by the human's input is not worth keeping
+            if (m_stop.load()) {
+                break;
+            }
+            if (!answered) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_cache[reply] = answer;
+        }
+    } // Ponderer::run(int const human)
+
+
+public:
+    Ponderer(Searcher &engine) : m_engine(&engine), m_stop(false), m_hits(0), m_misses(0) {
+    } // Ponderer::Ponderer(Searcher &engine)
+
+
+    ~Ponderer() {
+        stop();
+    } // Ponderer::~Ponderer()
+
+
+    /// @name start(InARowGame const &game, int const human)
+    /// @brief begin pondering the position with the human (piece 1 or 2) to move
+    void start(InARowGame const &game, int const human) {
+        stop();
+
+        m_game.reset(new InARowGame(game));
+        m_cache.clear();
+        m_stop = false;
+        m_thread = std::thread(&Ponderer::run, this, human);
+    } // Ponderer::start(InARowGame const &game, int const human)
+
+
+    /// @name stop()
+    /// @brief cancel the background search and wait for it to finish
+    void stop() {
+        m_stop = true;
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    } // Ponderer::stop()
+
+
+    /// @name lookup(int const reply, Move &answer)
+    /// @brief get the pondered answer to a reply
+    /// @returns true if the reply was pondered and 'answer' was set
+    bool lookup(int const reply, Move &answer) {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto const found = m_cache.find(reply);
+        if (found == m_cache.end()) {
+            m_misses++;
+            return false;
+        }
+
+        m_hits++;
+        answer = found->second;
+        return true;
+    } // Ponderer::lookup(int const reply, Move &answer)
+
+
+    /// @name process(InARowGame &game, const int turn)
+    /// @brief InARowGame::process() with the engine thinking on the human's time
+    Move process(InARowGame &game, const int turn) {
+        Move result;
+
+        if (turn) {
+            // the human is 'X' (turn 1); ponder while waiting on the input
+            start(game, 2);
+            result = game.human_move();
+            stop();
+        } else if (game.m_lastmove >= 0 && lookup(game.m_lastmove, result)) {
+            debug(1, cout << "ponder hit: " << coords(game.m_lastmove, game.m_grid) << "\n");
+            m_engine->clock().finish(turn, Deadline());
+        } else {
+            result = m_engine->think(game, turn);
+        }
+
+        return game.process(turn, result);
+    } // Ponderer::process(InARowGame &game, const int turn)
+
+
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+
+};  // class Ponderer
+
+#endif /* ponder_h */
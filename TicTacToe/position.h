@@ -0,0 +1,212 @@
+///
+///  @file position.h
+///  @brief the declaration and definition of the PackedBoard class
+///
+
+#ifndef position_h
+#define position_h
+
+#include <algorithm>
+#include <cstdint>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+/// @brief PackedBoard stores a board position at 2 bits per cell.
+///
+/// Cell n lives in bits 2*(n%32) and 2*(n%32)+1 of word n/32 with the same
+/// values as InARowGame::m_board (0 open, 1 'O', 2 'X'). Boards of up to
+/// Inline * 32 cells keep their words inside the object; bigger boards put
+/// them in a single heap block. A 7x7 board takes 2 words, 15x15 takes 8.
+///
+/// Unused bits are always zero so equality, ordering and hashing work a
+/// whole word at a time.
+///
+template<int Inline>
+class PackedBoard {
+public:
+    static int constexpr CellsPerWord = 32;
+
+    /// @brief hash functor for unordered containers
+    struct Hash {
+        size_t operator()(PackedBoard const &b) const { return size_t(b.hash()); }
+    };
+
+private:
+    union {
+        uint64_t    m_small[Inline];
+        uint64_t   *m_large;        // the words of boards beyond Inline * 32 cells
+    };
+    int             m_cells;
+
+    static int words_for(int const cells) { return (cells + CellsPerWord - 1) / CellsPerWord; }
+
+    bool large() const { return words() > Inline; }
+
+    /// @name reset(int const cells)
+    /// @brief drop the current words and make room for an empty board of 'cells'
+    void reset(int const cells) {
+        if (large()) {
+            delete [] m_large;
+        }
+        m_cells = cells;
+        if (large()) {
+            m_large = new uint64_t[words()]();
+        } else {
+            std::fill(m_small, m_small + Inline, 0);
+        }
+    } // PackedBoard::reset(int const cells)
+
+
+public:
+    explicit PackedBoard(int const cells = 0) :
+        m_cells(0) {
+        reset(cells);
+    } // PackedBoard::PackedBoard(int const cells)
+
+
+    template<typename T>
+    explicit PackedBoard(vector<T> const &board) : PackedBoard(int(board.size())) {
+        for (int n=0; n < m_cells; ++n) {
+            set(n, int(board[n]));
+        }
+    } // PackedBoard::PackedBoard(vector<T> const &board)
+
+
+    PackedBoard(PackedBoard const &rhs) : PackedBoard(rhs.m_cells) {
+        assign(rhs.data());
+    }
+
+    PackedBoard(PackedBoard &&rhs) :
+        m_cells(0) {
+        *this = std::move(rhs);
+    }
+
+    ~PackedBoard() {
+        reset(0);
+    }
+
+    PackedBoard &operator = (PackedBoard const &rhs) {
+        if (this != &rhs) {
+            if (words() != rhs.words()) {
+                reset(rhs.m_cells);
+            }
+            m_cells = rhs.m_cells;
+            assign(rhs.data());
+        }
+        return *this;
+    } // PackedBoard::operator = (PackedBoard const &rhs)
+
+    PackedBoard &operator = (PackedBoard &&rhs) {
+        if (this != &rhs) {
+            reset(0);
+            m_cells = rhs.m_cells;
+            if (large()) {
+                m_large = rhs.m_large;
+                rhs.m_cells = 0;
+            } else {
+                std::copy(rhs.m_small, rhs.m_small + Inline, m_small);
+            }
+        }
+        return *this;
+    } // PackedBoard::operator = (PackedBoard &&rhs)
+
+
+    int size() const { return m_cells; }
+    int words() const { return words_for(m_cells); }
+    uint64_t const *data() const { return large() ? m_large : m_small; }
+    uint64_t *data() { return large() ? m_large : m_small; }
+
+
+    inline int get(int const n) const {
+        return int(data()[n / CellsPerWord] >> ((n % CellsPerWord) * 2)) & 3;
+    }
+
+    /// @name set(int const n, int const piece)
+    /// @brief put 'piece' (0, 1 or 2) on cell n, replacing what was there
+    inline void set(int const n, int const piece) {
+        uint64_t &word = data()[n / CellsPerWord];
+        int const shift = (n % CellsPerWord) * 2;
+        word = (word & ~(uint64_t(3) << shift)) | (uint64_t(piece) << shift);
+    } // PackedBoard::set(int const n, int const piece)
+
+
+    /// @name toggle(int const n, int const piece)
+    /// @brief add 'piece' to an open cell or take it off again
+    inline void toggle(int const n, int const piece) {
+        data()[n / CellsPerWord] ^= uint64_t(piece) << ((n % CellsPerWord) * 2);
+    }
+
+
+    /// @name assign(uint64_t const *words)
+    /// @brief load the position from words() packed words
+    void assign(uint64_t const *words) {
+        std::copy(words, words + this->words(), data());
+    }
+
+
+    void clear() {
+        std::fill(data(), data() + words(), 0);
+    }
+
+
+    /// @name hash() const
+    /// @returns a well mixed 64 bit hash of the position
+    uint64_t hash() const {
+        uint64_t h = uint64_t(m_cells) * 0x9e3779b97f4a7c15ull;
+        uint64_t const *w = data();
+        for (int i=0, n=words(); i < n; ++i) {
+            h = (h ^ w[i]) * 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 31;
+        }
+        h *= 0x94d049bb133111ebull;
+        return h ^ (h >> 29);
+    } // PackedBoard::hash()
+
+
+    bool operator == (PackedBoard const &rhs) const {
+        return m_cells == rhs.m_cells && std::equal(data(), data() + words(), rhs.data());
+    }
+
+    bool operator != (PackedBoard const &rhs) const { return !(*this == rhs); }
+
+    bool operator < (PackedBoard const &rhs) const {
+        if (m_cells != rhs.m_cells) {
+            return m_cells < rhs.m_cells;
+        }
+        return std::lexicographical_compare(data(), data() + words(), rhs.data(), rhs.data() + words());
+    } // PackedBoard::operator < (PackedBoard const &rhs)
+
+
+    /// @name decode(vector<T> &board) const
+    /// @brief unpack the position into one value per cell
+    template<typename T>
+    void decode(vector<T> &board) const {
+        board.resize(m_cells);
+        uint64_t const *w = data();
+        for (int n=0; n < m_cells; ++n) {
+            board[n] = T((w[n / CellsPerWord] >> ((n % CellsPerWord) * 2)) & 3);
+        }
+    } // PackedBoard::decode(vector<T> &board)
+
+
+    /// @name to_string(char const pieces[3]) const
+    /// @returns one character per cell
+    string to_string(char const pieces[3]) const {
+        string res(m_cells, pieces[0]);
+        for (int n=0; n < m_cells; ++n) {
+            res[n] = pieces[get(n)];
+        }
+        return res;
+    } // PackedBoard::to_string(char const pieces[3])
+
+};  // class PackedBoard
+
+
+/// the position type InARowGame keeps; boards up to 8x8 need no heap
+typedef PackedBoard<2> Position;
+
+#endif /* position_h */
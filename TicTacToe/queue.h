@@ -0,0 +1,85 @@
+///
+///  @file queue.h
+///  @brief the declaration and definition of the MpscQueue class
+///
+
+#ifndef queue_h
+#define queue_h
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/// @brief MpscQueue is an unbounded lock-free queue for many producer
+/// threads and one consumer thread.
+///
+/// Producers link a new node in with a single atomic exchange, so a push
+/// never waits on another thread. The consumer owns the tail and follows
+/// the links; a push that has swapped the head but not yet linked its node
+/// is simply not visible yet and is picked up by a later pop().
+///
+template<typename T>
+class MpscQueue {
+private:
+    struct Node {
+        std::atomic<Node *> next;
+        T                   value;
+
+        Node() : next(nullptr) {}
+        explicit Node(T &&v) : next(nullptr), value(std::move(v)) {}
+    };
+
+    std::atomic<Node *>     m_head;     // the newest node; producers push here
+    Node                   *m_tail;     // the node before the oldest value; consumer only
+    std::atomic<size_t>     m_size;
+
+public:
+    MpscQueue() :
+        m_head(new Node()),
+        m_size(0) {
+        m_tail = m_head.load();
+    } // MpscQueue::MpscQueue()
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete m_tail;
+    } // MpscQueue::~MpscQueue()
+
+    MpscQueue(MpscQueue const &) = delete;
+    MpscQueue &operator = (MpscQueue const &) = delete;
+
+
+    /// @name push(T value)
+    /// @brief add a value; safe from any number of threads at once
+    void push(T value) {
+        Node *node = new Node(std::move(value));
+        m_size.fetch_add(1, std::memory_order_relaxed);
+        Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    } // MpscQueue::push(T value)
+
+
+    /// @name pop(T &value)
+    /// @brief take the oldest value; only ever call from the one consumer thread
+    /// @returns true if 'value' was set
+    bool pop(T &value) {
+        Node *next = m_tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete m_tail;
+        m_tail = next;
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    } // MpscQueue::pop(T &value)
+
+
+    /// @returns the number of values pushed but not popped (approximate while threads push)
+    size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+};  // class MpscQueue
+
+#endif /* queue_h */
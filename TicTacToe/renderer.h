@@ -0,0 +1,189 @@
+///
+///  @file renderer.h
+///  @brief the declaration and definition of the Renderer class
+///
+
+#ifndef renderer_h
+#define renderer_h
+
+#include <chrono>
+#include <cstdint>
+
+#include <iostream>
+using std::cout;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "game.h"
+
+/// @brief Renderer keeps a game on the terminal in place with ANSI cursor
+/// positioning instead of printing a fresh board every move.
+///
+/// The first frame clears the screen and draws the legend and every cell.
+/// After that a frame sends only the cells whose piece or highlight changed
+/// since the last one and the status line when its text changed, then parks
+/// the cursor under the board and clears the rest of the screen so prompts
+/// and messages appear below it. Each frame is built in one string and
+/// written with a single write.
+///
+/// With a frame rate cap, frames asked for sooner than 1 / fps seconds after
+/// the last one drawn are skipped: the next frame drawn catches up on every
+/// change since, so a fast self-play run is watched at the cap's speed and
+/// not slowed down to the terminal's. The last move and a winning Line are
+/// shown in bold.
+///
+class Renderer {
+private:
+    using clock = std::chrono::steady_clock;
+
+    double          m_interval;     // seconds between frames; 0 draws every frame
+    clock::time_point m_next;       // the earliest time the next frame is drawn
+    bool            m_drawn;        // the screen holds the legend and a board
+    int             m_grid;
+    int             m_dims;
+    int             m_layer_rows;   // screen rows for each grid x grid slice
+    int             m_status_row;
+    vector<uint8_t> m_shown;        // what each cell shows: piece, plus 4 when bold
+    string          m_status;       // the status line as shown
+    string          m_frame;        // the frame being built
+    uint64_t        m_frames;
+    uint64_t        m_skipped;
+
+    /// @brief find the screen column and row of a cell
+    inline void locate(int const index, int &col, int &row) const {
+        int const layer = m_grid * m_grid;
+        col = 1 + (Legend ? 3 : 0) + 2 * (index % m_grid);
+        row = 1 + (index / layer) * m_layer_rows + (m_dims > 2) + Legend + (index / m_grid) % m_grid;
+    } // Renderer::locate(int const index, int &col, int &row)
+
+
+    /// @name layout(InARowGame const &game)
+    /// @brief clear the screen and draw the parts of a board that never change
+    void layout(InARowGame const &game) {
+        int const layer = game.m_grid * game.m_grid;
+        int const layers = game.m_cells / layer;
+
+        m_grid = game.m_grid;
+        m_dims = game.m_dims;
+        m_layer_rows = (m_dims > 2) + Legend + m_grid + 1;
+        m_status_row = 1 + layers * m_layer_rows;
+        m_shown.assign(game.m_cells, 0xff);
+        m_status.clear();
+
+        m_frame += cursOff + resetAttr + clearScreen;
+        for (int l=0; l < layers; ++l) {
+            int row = 1 + l * m_layer_rows;
+            if (m_dims > 2) {
+                // one slice at a time, named by its place along the other axes
+                m_frame += cursPos(1, row++) + "layer";
+                for (int d=2, rest=l; d < m_dims; ++d, rest /= m_grid) {
+                    m_frame += " " + itoa(rest % m_grid);
+                }
+                m_frame += ":";
+            }
+            if (Legend) {
+                m_frame += cursPos(1, row++) + "   ";
+                for (int c=0; c < m_grid; ++c) {
+                    m_frame += itoa(c, 26) + " ";
+                }
+                for (int r=0; r < m_grid; ++r) {
+                    m_frame += cursPos(2, row + r) + char('A' + r);
+                }
+            }
+        }
+        m_drawn = true;
+    } // Renderer::layout(InARowGame const &game)
+
+
+    /// @brief send the frame built so far in one write
+    void flush() {
+        cout.write(m_frame.data(), std::streamsize(m_frame.size()));
+        cout.flush();
+        m_frame.clear();
+    }
+
+public:
+    /// @brief draw at most 'fps' frames a second (0: every frame asked for)
+    explicit Renderer(double const fps = 0.0) :
+        m_interval(fps > 0.0 ? 1.0 / fps : 0.0),
+        m_drawn(false),
+        m_grid(0),
+        m_dims(0),
+        m_layer_rows(0),
+        m_status_row(1),
+        m_frames(0),
+        m_skipped(0) {
+    } // Renderer::Renderer(double const fps)
+
+
+    uint64_t frames() const { return m_frames; }
+    uint64_t skipped() const { return m_skipped; }
+
+
+    /// @name frame(InARowGame const &game, string const &status, bool const force = false)
+    /// @brief bring the screen up to date with the game and status line,
+    /// unless the frame rate cap says to skip this frame and 'force' is false
+    void frame(InARowGame const &game, string const &status, bool const force = false) {
+        clock::time_point const now = clock::now();
+        if (m_drawn && !force && now < m_next) {
+            m_skipped++;
+            return;
+        }
+        m_next = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(m_interval));
+        m_frames++;
+
+        if (!m_drawn || game.m_grid != m_grid || game.m_dims != m_dims) {
+            layout(game);
+        }
+
+        vector<uint8_t> bold(game.m_cells, 0);
+        if (game.m_lastmove >= 0) {
+            bold[game.m_lastmove] = 4;
+        }
+        for (int const w : game.m_windexes) {
+            bold[w] = 4;
+        }
+
+        for (int index=0; index < game.m_cells; ++index) {
+            uint8_t const shows = uint8_t(game.m_board[index] | bold[index]);
+            if (shows == m_shown[index]) {
+                continue;
+            }
+            int col, row;
+            locate(index, col, row);
+            m_frame += cursPos(col, row);
+            m_frame += bold[index] ? boldAttr : "";
+            m_frame += InARowGame::m_dispPieces[game.m_board[index]];
+            m_frame += bold[index] ? resetAttr : "";
+            m_shown[index] = shows;
+        }
+
+        if (status != m_status) {
+            m_frame += cursPos(1, m_status_row) + status + clearEOL;
+            m_status = status;
+        }
+
+        // anything else printed goes under the board
+        m_frame += cursPos(1, m_status_row + 1) + clearEOS;
+        flush();
+    } // Renderer::frame(...)
+
+
+    /// @name finish()
+    /// @brief leave the cursor under the board and visible again
+    void finish() {
+        if (m_drawn) {
+            m_frame += cursPos(1, m_status_row + 1) + clearEOS;
+        }
+        m_frame += cursOn;
+        flush();
+    } // Renderer::finish()
+
+};  // class Renderer
+
+#endif /* renderer_h */
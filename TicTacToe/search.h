@@ -0,0 +1,357 @@
+///
+///  @file search.h
+///  @brief the declaration and definition of the Searcher class
+///
+
+#ifndef search_h
+#define search_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "move.h"
+#include "line.h"
+#include "game.h"
+#include "timecontrol.h"
+
+/// @brief Searcher looks deeper than the one-ply engine when the TimeControl
+/// gives it a budget.
+///
+/// It runs an iterative deepening alpha-beta search over the Line patterns:
+///
+///     - a side with a FORCED Line of its own wins immediately
+///     - a side facing two different FORCED cells of the other side has lost
+///     - a side facing one FORCED cell must block it
+///     - otherwise the open cells of the Lines that can still be won are
+///       searched, busiest cells first. Cells on no such Line are never
+///       worth more than passing and are not searched. With a candidate
+///       radius only the cells near a piece are, unless none of them is on
+///       such a Line.
+///     - in a gravity game only the lowest open cell of each column can be
+///       played, threats above it wait, and every column is searched
+///     - a position where no Line can still be won is a draw
+///
+/// Moves are made and taken back on the game being searched (place() and
+/// unplace()) so no positions are copied. The search stops when the Deadline
+/// expires and always answers with the best move of the deepest completed
+/// iteration; the game is left exactly as it was.
+///
+class Searcher {
+public:
+    static int constexpr Win = 1000000;     // score for a won game (less the plies to get there)
+    static int constexpr MaxPly = 4096;     // scores beyond Win - MaxPly are decided games
+
+private:
+    TimeControl    *m_clock;
+    Deadline        m_deadline;             // the budget for the current decision
+    bool            m_aborted;              // the current iteration ran out of budget
+    int             m_depth;                // depth of the last completed iteration
+    uint64_t        m_nodes;                // total nodes searched
+
+
+    /// @name generate(InARowGame const &game, int const mover, int const ply, vector<int> &moves, int &value)
+    /// @brief find the moves worth searching for 'mover' (piece 1 or 2)
+    /// @returns true if the position is decided and 'value' holds its score for 'mover'
+    bool generate(InARowGame const &game, int const mover, int const ply, vector<int> &moves, int &value) const {
+        vector<int> weight(game.m_board.size(), 0);
+        int block = -1;
+        bool lost = false;
+        bool live = false;
+
+        moves.clear();
+
+        for (int const n : game.m_active) {
+            Line const line = game.m_lines[n];
+            Pattern const p = line.pattern();
+
+            switch (p.key) {
+                case WINNER:
+                    value = (p.owner == mover) ? Win - ply : -(Win - ply);
+                    return true;
+
+                case FORCED: {
+                    int const cell = line.cell(line.m_length <= 16 ? p.first() : line.open_cells()[0]);
+                    live = true;
+                    if (!game.playable(cell)) {
+                        // a gravity threat that can't be played yet
+                        break;
+                    }
+                    if (p.owner == mover) {
+                        // win right now
+                        value = Win - ply - 1;
+                        moves.assign(1, cell);
+                        return true;
+                    }
+                    if (block >= 0 && block != cell) {
+                        // two different threats can't both be blocked
+                        // (unless a win of our own turns up in a later Line)
+                        lost = true;
+                    }
+                    block = cell;
+                    break;
+                }
+
+                case RANDOM1: {
+                    // the Line can still be won; weigh its open cells by how full it is
+                    int const filled = line.m_length - p.empties;
+                    line.for_open(p, [&](int const cell) { weight[cell] += 1 + filled * filled; });
+                    live = true;
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        if (lost) {
+            value = -(Win - ply - 2);
+            moves.assign(1, block);
+            return true;
+        }
+
+        if (!live) {
+            // nobody can win any more
+            value = 0;
+            return true;
+        }
+
+        if (block >= 0) {
+            moves.push_back(block);
+            return false;
+        }
+
+        if (game.m_gravity) {
+            // every column matters: a move changes which cells can be reached
+            for (int c=0; c < game.m_grid; ++c) {
+                int const n = game.drop(c);
+                if (n >= 0) {
+                    moves.push_back(n);
+                }
+            }
+        } else {
+            game.for_candidates([&](int const n) {
+                if (weight[n] > 0) {
+                    moves.push_back(n);
+                }
+            });
+            if (moves.empty()) {
+                // the Lines still open all lie beyond the candidate radius
+                for (int n=0; n < int(game.m_board.size()); ++n) {
+                    if (weight[n] > 0) {
+                        moves.push_back(n);
+                    }
+                }
+            }
+        }
+        std::stable_sort(moves.begin(), moves.end(), [&](int const a, int const b) { return weight[a] > weight[b]; });
+
+        return false;
+    } // Searcher::generate(...)
+
+
+    /// @name evaluate(InARowGame const &game, int const mover) const
+    /// @brief the static score of a quiet position for 'mover', from the
+    /// game's network when it has weights attached
+    int evaluate(InARowGame const &game, int const mover) const {
+        if (game.m_nnue.active()) {
+            int const score = game.m_nnue.evaluate();
+            return (mover == 2) ? score : -score;
+        }
+
+        int total = 0;
+
+        for (int const n : game.m_active) {
+            Line const line = game.m_lines[n];
+            Pattern const p = line.pattern();
+            if (p.owner != 0 && (p.key == RANDOM1 || p.key == FORCED)) {
+                int const filled = line.m_length - p.empties;
+                int const value = filled * filled * filled;
+                total += (p.owner == mover) ? value : -value;
+            }
+        }
+
+        return total;
+    } // Searcher::evaluate(...)
+
+
+    /// @name negamax(...)
+    /// @brief depth limited alpha-beta search
+    /// @returns the score of the position for 'mover'
+    int negamax(InARowGame &game, int const mover, int const depth, int alpha, int const beta, int const ply) {
+        if (m_deadline.expired()) {
+            m_aborted = true;
+            return 0;
+        }
+
+        vector<int> moves;
+        int value = 0;
+        if (generate(game, mover, ply, moves, value)) {
+            return value;
+        }
+
+        if (depth <= 0) {
+            return evaluate(game, mover);
+        }
+
+        int best = -Win - 1;
+        for (int const cell : moves) {
+            game.place(cell, mover);
+            int const score = -negamax(game, 3 - mover, depth - 1, -beta, -alpha, ply + 1);
+            game.unplace(cell);
+
+            if (m_aborted) {
+                return 0;
+            }
+
+            if (score > best) {
+                best = score;
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        return best;
+    } // Searcher::negamax(...)
+
+
+public:
+    Searcher(TimeControl &clock) :
+        m_clock(&clock),
+        m_aborted(false),
+        m_depth(0),
+        m_nodes(0) {
+    } // Searcher::Searcher(TimeControl &clock)
+
+
+    TimeControl &clock() const { return *m_clock; }
+    int depth() const { return m_depth; }
+    uint64_t nodes() const { return m_nodes; }
+
+
+    /// @name search(InARowGame &game, int const mover, Deadline const &deadline)
+    /// @brief choose a move for 'mover' (piece 1 or 2) within the deadline
+    /// @returns the move of the deepest completed iteration. The Move's key
+    ///          is the one-ply classification of the position.
+    Move search(InARowGame &game, int const mover, Deadline const &deadline) {
+        Move result = game.think();
+        m_depth = 0;
+
+        if (result.key == WINNER || result.key == NOMOVE || !deadline.limited()) {
+            return result;
+        }
+
+        m_deadline = deadline;
+        m_aborted = false;
+
+        vector<int> moves;
+        int value = 0;
+        if (generate(game, mover, 0, moves, value)) {
+            // won, lost, or dead drawn: no need to look any deeper
+            if (!moves.empty()) {
+                result.value = moves[0];
+            }
+            m_nodes += m_deadline.nodes();
+            return result;
+        }
+
+        if (moves.size() == 1) {
+            result.key = FORCED;
+            result.value = moves[0];
+            m_nodes += m_deadline.nodes();
+            return result;
+        }
+
+        int empty = 0;
+        for (int const c : game.m_board) {
+            empty += (c == 0);
+        }
+
+        int best = moves[0];
+        for (int depth=1; depth <= empty; ++depth) {
+            int alpha = -Win - 1;
+            int iteration_best = moves[0];
+
+            for (int const cell : moves) {
+                game.place(cell, mover);
+                int const score = -negamax(game, 3 - mover, depth - 1, -Win - 1, -alpha, 1);
+                game.unplace(cell);
+
+                if (m_aborted) {
+                    break;
+                }
+
+                if (score > alpha) {
+                    alpha = score;
+                    iteration_best = cell;
+                }
+            }
+
+            if (m_aborted) {
+                break;
+            }
+
+            // search the best move first in the next iteration
+            best = iteration_best;
+            m_depth = depth;
+            std::stable_partition(moves.begin(), moves.end(), [best](int const c) { return c == best; });
+
+            if (alpha >= Win - MaxPly || alpha <= -(Win - MaxPly)) {
+                break;
+            }
+        }
+
+        m_nodes += m_deadline.nodes();
+        result.value = best;
+        return result;
+    } // Searcher::search(...)
+
+
+    /// @name think(InARowGame &game, int const turn)
+    /// @brief decide the engine's move for 'turn' (0 or 1) on the clock
+    /// @returns the Move to make
+    Move think(InARowGame &game, int const turn) {
+        if (m_clock->mode() == TimeControl::UNLIMITED) {
+            return game.think();
+        }
+
+        int empty = 0;
+        for (int const c : game.m_board) {
+            empty += (c == 0);
+        }
+
+        Deadline const deadline = m_clock->start(turn, (empty + 1) / 2);
+        Move const result = search(game, (turn == 0) ? 1 : 2, deadline);
+        m_clock->finish(turn, deadline);
+
+        return result;
+    } // Searcher::think(InARowGame &game, int const turn)
+
+
+    /// @name ponder(InARowGame &game, int const turn, std::atomic<bool> const *stop)
+    /// @brief think about a move off the clock, giving up as soon as 'stop' is set
+    Move ponder(InARowGame &game, int const turn, std::atomic<bool> const *stop) {
+        if (m_clock->mode() == TimeControl::UNLIMITED) {
+            return game.think();
+        }
+
+        int empty = 0;
+        for (int const c : game.m_board) {
+            empty += (c == 0);
+        }
+
+        return search(game, (turn == 0) ? 1 : 2, m_clock->start(turn, (empty + 1) / 2, stop));
+    } // Searcher::ponder(...)
+
+};  // class Searcher
+
+#endif /* search_h */
@@ -0,0 +1,669 @@
+///
+///  @file server.h
+///  @brief the declaration and definition of the Server class
+///
+
+#ifndef server_h
+#define server_h
+
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <iostream>
+using std::cout;
+using std::cerr;
+
+#include <sstream>
+using std::stringstream;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "move.h"
+#include "game.h"
+#include "search.h"
+#include "threadpool.h"
+#include "timecontrol.h"
+
+/// @brief Server hosts InARowGame sessions for other processes.
+///
+/// Listens on a Unix domain socket (any address that isn't a number) or on
+/// a localhost TCP port (an address that is a number). Every connection is
+/// a session with its own game. All sessions are served from one thread by
+/// a poll() event loop over non-blocking sockets. The engine's searches
+/// ("best" and "go") run on a WorkStealingPool and wake the loop through a
+/// pipe when they finish, so a long search never holds up other sessions;
+/// the searching session's own later commands wait until it answers.
+///
+/// When the process runs out of file descriptors a connection is accepted
+/// on a spare descriptor kept for the purpose and closed at once, so the
+/// listening socket doesn't stay readable and spin the loop.
+///
+/// The protocol is one command per line, one response line per command.
+/// Responses start with "ok" or "error". Cells are board indexes or
+/// coordinates as shown by the board legend (e.g. "D3"); every response
+/// names cells by their coordinates, so they can be sent back as they are.
+/// In a gravity game a move must name the lowest open cell of its column,
+/// or use drop.
+///
+///     Command         Response
+///     =======================================================================================
+///     new             ok new <grid> <base>                start a new game of the same size
+///     size <g> <b>    ok size <grid> <base>               start a new game of that size
+///     move <cell>     ok move <cell> <status>             make the move for the side to move
+///     drop <column>   ok move <cell> <status>             in a gravity game, drop a piece in the column
+///     best            ok best <cell> <key>                the engine's choice; not played
+///     go              ok move <cell> <status>             the engine makes its move
+///     analyze         ok analyze <key> <cell> <cells>     the one-ply analysis of the position
+///     board           ok board <state>                    one character per cell
+///     quit                                                close the session
+///
+/// <status> is "play" while the game goes on, "win O", "win X", or "draw".
+///
+class Server {
+public:
+    static size_t constexpr MaxLine = 4096;     // longest command accepted
+    static int constexpr MaxGrid = 26;          // widest board a session may ask for: rows are named A to Z
+
+private:
+    /// @brief the state kept for each connected client
+    struct Session {
+        int                         fd;
+        string                      in;     // bytes received but not yet processed
+        string                      out;    // responses not yet sent
+        std::unique_ptr<InARowGame> game;
+        int                         turn;   // 1 for the first move, as in tictactoe()
+        bool                        over;   // the game has been won or drawn
+        bool                        closing;
+        string                      thinking;   // the command a search is running for, if any
+
+        Session(int const f) : fd(f), game(new InARowGame()), turn(1), over(false), closing(false) {
+        }
+    };
+
+    /// @brief a search the pool has finished
+    struct Answer {
+        Session    *session;
+        Move        move;
+    };
+
+    TimeControl        &m_clock;
+    size_t              m_threads;      // search workers; 0 is one per core
+    std::unique_ptr<WorkStealingPool> m_pool;
+    int                 m_wake[2];      // a pipe the pool writes to when a search finishes
+    std::mutex          m_lock;         // guards m_answers
+    vector<Answer>      m_answers;
+    int                 m_reserve;      // a spare descriptor to turn connections away with
+    bool                m_full;         // out of descriptors: don't poll for connections for a while
+    size_t              m_refused;      // connections turned away for want of a descriptor
+    int                 m_listen;
+    string              m_path;         // Unix socket path to remove on exit
+    vector<std::unique_ptr<Session>> m_sessions;
+    size_t              m_served;       // sessions accepted since start
+    bool                m_running;
+
+
+    static void set_nonblocking(int const fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+
+    /// @name parse_cell(string const &text, int const grid, int &cell)
+    /// @brief read a board index or a legend coordinate such as "D3"
+    /// @returns true if 'text' names a cell on a board 'grid' wide
+    static bool parse_cell(string const &text, int const grid, int &cell) {
+        if (text.empty()) {
+            return false;
+        }
+
+        if (isdigit(text[0])) {
+            cell = atoi(text.c_str());
+        } else if (text.length() == 2) {
+            int const row = tolower(text[0]) - 'a';
+            int const col = isdigit(text[1]) ? text[1] - '0' : tolower(text[1]) - 'a' + 10;
+            if (row < 0 || row >= grid || col < 0 || col >= grid) {
+                return false;
+            }
+            cell = row * grid + col;
+        } else {
+            return false;
+        }
+
+        return cell >= 0 && cell < grid * grid;
+    } // Server::parse_cell(string const &text, int const grid, int &cell)
+
+
+    /// @name parse_column(string const &text, int const grid, int &column)
+    /// @brief read a column number or its legend character such as "3" or "b"
+    /// @returns true if 'text' names a column on a board 'grid' wide
+    static bool parse_column(string const &text, int const grid, int &column) {
+        if (text.empty()) {
+            return false;
+        }
+
+        if (isdigit(text[0])) {
+            column = atoi(text.c_str());
+        } else if (text.length() == 1 && isalpha(text[0])) {
+            column = tolower(text[0]) - 'a' + 10;
+        } else {
+            return false;
+        }
+
+        return column >= 0 && column < grid;
+    } // Server::parse_column(string const &text, int const grid, int &column)
+
+
+    static string key_name(movetype_e const key) {
+        switch (key) {
+            case NOMOVE:  return "NOMOVE";
+            case RANDOM2: return "RANDOM2";
+            case RANDOM1: return "RANDOM1";
+            case FORCED:  return "FORCED";
+            case WINNER:  return "WINNER";
+            default:      return "ZERO";
+        }
+    } // Server::key_name(movetype_e const key)
+
+
+    /// @name play(Session &s, Move const &move)
+    /// @brief make a move in a session's game
+    /// @returns the response line
+    static string play(Session &s, Move const &move) {
+        InARowGame &game = *s.game;
+        int const turn = s.turn & 1;
+
+        game.make_move(move, turn, false);
+        s.turn++;
+
+        Move const status = game.score();
+        stringstream ss;
+        ss << "ok move " << coords(move.value, game.m_grid) << " ";
+        if (status.key == WINNER) {
+            s.over = true;
+            ss << "win " << InARowGame::m_dispPieces[status.value];
+        } else if (status.key == NOMOVE) {
+            s.over = true;
+            ss << "draw";
+        } else {
+            ss << "play";
+        }
+
+        return ss.str();
+    } // Server::play(Session &s, Move const &move)
+
+
+    /// @name engine_move(InARowGame &game, int const turn) const
+    /// @brief the engine's choice for the side to move, off the game clocks;
+    /// runs on a pool worker, so it only reads the shared TimeControl
+    Move engine_move(InARowGame &game, int const turn) const {
+        if (m_clock.mode() == TimeControl::UNLIMITED) {
+            return game.think();
+        }
+
+        int empty = 0;
+        for (int const c : game.m_board) {
+            empty += (c == 0);
+        }
+
+        Searcher engine(m_clock);
+        return engine.search(game, (turn == 0) ? 1 : 2, m_clock.start(turn, (empty + 1) / 2));
+    } // Server::engine_move(InARowGame &game, int const turn)
+
+
+    /// @name think(Session &s, string const &cmd)
+    /// @brief start the engine's search for a "best" or "go" on the pool;
+    /// answer() sends the response when it is done
+    void think(Session &s, string const &cmd) {
+        Session *const session = &s;
+        s.thinking = cmd;
+        m_pool->submit([this, session] {
+            Move const move = engine_move(*session->game, session->turn & 1);
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_answers.push_back({ session, move });
+            }
+            char const wake = 1;
+            while (write(m_wake[1], &wake, 1) < 0 && errno == EINTR) {
+            }
+        });
+    } // Server::think(Session &s, string const &cmd)
+
+
+    /// @name answer()
+    /// @brief respond to every search the pool has finished and go on with
+    /// the commands that came in while each one ran
+    void answer() {
+        char buff[256];
+        while (read(m_wake[0], buff, sizeof(buff)) > 0) {
+        }
+
+        vector<Answer> answers;
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            answers.swap(m_answers);
+        }
+        for (Answer const &a : answers) {
+            Session &s = *a.session;
+            string const cmd = s.thinking;
+            s.thinking.clear();
+            if (s.fd < 0) {
+                // the client left while the engine thought
+                continue;
+            }
+            if (cmd == "best") {
+                s.out += "ok best " + coords(a.move.value, s.game->m_grid) + " " + key_name(a.move.key) + "\n";
+            } else {
+                s.out += play(s, a.move) + "\n";
+            }
+            serve(s);
+        }
+    } // Server::answer()
+
+
+    /// @name command(Session &s, string const &line)
+    /// @brief run one protocol command
+    /// @returns the response line, or nothing for a search still running
+    string command(Session &s, string const &line) {
+        stringstream in(line);
+        string cmd;
+        in >> cmd;
+        for (char &c : cmd) {
+            c = char(tolower(c));
+        }
+
+        if (cmd == "new") {
+            s.game->init_board();
+            s.turn = 1;
+            s.over = false;
+            return "ok new " + itoa(s.game->m_grid) + " " + itoa(s.game->m_base);
+        }
+
+        if (cmd == "size") {
+            int grid = 0, base = 0;
+            if (!(in >> grid >> base)) {
+                return "error usage: size <grid> <base>";
+            }
+            if (grid < 1 || grid > MaxGrid || base < 1 || base > grid || base > MaxLineBase) {
+                return "error size must be 1 <= base <= grid <= " + itoa(MaxGrid) + " and base <= " + itoa(MaxLineBase);
+            }
+            s.game.reset(new InARowGame(grid, base));
+            s.turn = 1;
+            s.over = false;
+            return "ok size " + itoa(grid) + " " + itoa(base);
+        }
+
+        if (cmd == "board") {
+            return "ok board " + s.game->state().to_string(InARowGame::m_dispPieces);
+        }
+
+        if (cmd == "analyze") {
+            Move const m = s.game->score();
+            stringstream ss;
+            ss << "ok analyze " << key_name(m.key) << " " << coords(m.value, s.game->m_grid);
+            for (int const c : m.choices) {
+                ss << " " << coords(c, s.game->m_grid);
+            }
+            return ss.str();
+        }
+
+        if (cmd == "quit") {
+            s.closing = true;
+            return "ok bye";
+        }
+
+        if (s.over && (cmd == "move" || cmd == "drop" || cmd == "go" || cmd == "best")) {
+            return "error the game is over";
+        }
+
+        if (cmd == "move") {
+            string text;
+            int cell = -1;
+            in >> text;
+            if (!parse_cell(text, s.game->m_grid, cell) || !s.game->playable(cell)) {
+                return "error invalid square: " + text;
+            }
+            return play(s, Move(FORCED, cell));
+        }
+
+        if (cmd == "drop") {
+            string text;
+            int column = -1;
+            in >> text;
+            if (!parse_column(text, s.game->m_grid, column)) {
+                return "error invalid column: " + text;
+            }
+            if (!s.game->m_gravity) {
+                return "error drop needs a gravity game";
+            }
+            int const cell = s.game->drop(column);
+            if (cell < 0) {
+                return "error column full: " + text;
+            }
+            return play(s, Move(FORCED, cell));
+        }
+
+        if (cmd == "best" || cmd == "go") {
+            // answered by answer() once the search is done
+            think(s, cmd);
+            return "";
+        }
+
+        return "error unknown command: " + cmd;
+    } // Server::command(Session &s, string const &line)
+
+
+    /// @name serve(Session &s)
+    /// @brief answer each complete line received, up to one that starts a search
+    void serve(Session &s) {
+        size_t start = 0;
+        size_t end;
+        while (!s.closing && s.thinking.empty() && (end = s.in.find('\n', start)) != string::npos) {
+            string line = s.in.substr(start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                string const response = command(s, line);
+                if (!response.empty()) {
+                    s.out += response + "\n";
+                }
+            }
+        }
+        s.in.erase(0, start);
+
+        // lines waiting on a search are kept; only an unfinished one is measured
+        size_t const last = s.in.rfind('\n');
+        if (s.in.size() - (last == string::npos ? 0 : last + 1) > MaxLine) {
+            s.out += "error line too long\n";
+            s.closing = true;
+        }
+    } // Server::serve(Session &s)
+
+
+    /// @name receive(Session &s)
+    /// @brief read what is waiting on a session and answer each complete line
+    /// @returns false if the session should be closed
+    bool receive(Session &s) {
+        char buff[4096];
+
+        while (true) {
+            ssize_t const n = read(s.fd, buff, sizeof(buff));
+            if (n > 0) {
+                s.in.append(buff, n);
+                continue;
+            }
+            if (n == 0) {
+                return false;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+
+        serve(s);
+        return true;
+    } // Server::receive(Session &s)
+
+
+    /// @name send(Session &s)
+    /// @brief write as much pending output as the socket takes
+    /// @returns false if the session should be closed
+    bool send(Session &s) {
+        while (!s.out.empty()) {
+            ssize_t const n = write(s.fd, s.out.data(), s.out.size());
+            if (n > 0) {
+                s.out.erase(0, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            }
+            return false;
+        }
+
+        return !s.closing;
+    } // Server::send(Session &s)
+
+
+    /// @name accept_all()
+    /// @brief accept every pending connection as a new session
+    void accept_all() {
+        while (true) {
+            int const fd = accept(m_listen, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EMFILE || errno == ENFILE) {
+                    // the connection stays queued and the socket readable: take
+                    // it on the spare descriptor and close it, or wait a while
+                    if (m_reserve < 0) {
+                        m_full = true;
+                        break;
+                    }
+                    close(m_reserve);
+                    int const turned = accept(m_listen, nullptr, nullptr);
+                    if (turned >= 0) {
+                        close(turned);
+                        m_refused++;
+                    }
+                    m_reserve = open("/dev/null", O_RDONLY);
+                    if (turned < 0) {
+                        break;
+                    }
+                    continue;
+                }
+                break;
+            }
+            set_nonblocking(fd);
+            m_sessions.emplace_back(new Session(fd));
+            m_served++;
+        }
+    } // Server::accept_all()
+
+
+public:
+    /// @brief serve games searched within 'clock' on 'threads' search workers (0: one per core)
+    explicit Server(TimeControl &clock, size_t const threads = 0) :
+        m_clock(clock),
+        m_threads(threads),
+        m_wake { -1, -1 },
+        m_reserve(-1),
+        m_full(false),
+        m_refused(0),
+        m_listen(-1),
+        m_served(0),
+        m_running(false) {
+    } // Server::Server(TimeControl &clock, size_t const threads)
+
+
+    ~Server() {
+        // finish the searches before the sessions they search go
+        m_pool.reset();
+        for (int const fd : { m_wake[0], m_wake[1], m_reserve }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        for (auto &s : m_sessions) {
+            if (s->fd >= 0) {
+                close(s->fd);
+            }
+        }
+        if (m_listen >= 0) {
+            close(m_listen);
+        }
+        if (!m_path.empty()) {
+            unlink(m_path.c_str());
+        }
+    } // Server::~Server()
+
+
+    /// @name listen_on(string const &address)
+    /// @brief open the listening socket
+    /// @param address a TCP port number on localhost, or a Unix socket path
+    /// @returns true on success
+    bool listen_on(string const &address) {
+        bool const tcp = !address.empty() && address.find_first_not_of("0123456789") == string::npos;
+
+        if (tcp) {
+            m_listen = socket(AF_INET, SOCK_STREAM, 0);
+            if (m_listen < 0) {
+                cerr << "socket: " << strerror(errno) << "\n";
+                return false;
+            }
+
+            int const yes = 1;
+            setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+            sockaddr_in addr {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(uint16_t(atoi(address.c_str())));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(m_listen, (sockaddr *) &addr, sizeof(addr)) < 0) {
+                cerr << "bind " << address << ": " << strerror(errno) << "\n";
+                return false;
+            }
+        } else {
+            m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (m_listen < 0) {
+                cerr << "socket: " << strerror(errno) << "\n";
+                return false;
+            }
+
+            sockaddr_un addr {};
+            addr.sun_family = AF_UNIX;
+            if (address.size() >= sizeof(addr.sun_path)) {
+                cerr << "socket path too long: " << address << "\n";
+                return false;
+            }
+            strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+            unlink(address.c_str());
+            if (bind(m_listen, (sockaddr *) &addr, sizeof(addr)) < 0) {
+                cerr << "bind " << address << ": " << strerror(errno) << "\n";
+                return false;
+            }
+            m_path = address;
+        }
+
+        if (listen(m_listen, SOMAXCONN) < 0) {
+            cerr << "listen: " << strerror(errno) << "\n";
+            return false;
+        }
+
+        set_nonblocking(m_listen);
+        return true;
+    } // Server::listen_on(string const &address)
+
+
+    /// @name run()
+    /// @brief serve sessions until stop() is called
+    void run() {
+        vector<pollfd> fds;
+
+        signal(SIGPIPE, SIG_IGN);
+        if (m_wake[0] < 0) {
+            if (pipe(m_wake) < 0) {
+                cerr << "pipe: " << strerror(errno) << "\n";
+                return;
+            }
+            set_nonblocking(m_wake[0]);
+            set_nonblocking(m_wake[1]);
+            m_reserve = open("/dev/null", O_RDONLY);
+            m_pool.reset(new WorkStealingPool(m_threads));
+        }
+        m_running = true;
+
+        while (m_running) {
+            int const timeout = m_full ? 100 : 1000;
+            fds.clear();
+            fds.push_back({ m_listen, short(m_full ? 0 : POLLIN), 0 });
+            fds.push_back({ m_wake[0], POLLIN, 0 });
+            for (auto const &s : m_sessions) {
+                short const events = short(POLLIN | (s->out.empty() ? 0 : POLLOUT));
+                fds.push_back({ s->fd, events, 0 });      // a closed session still searching has fd -1: ignored
+            }
+            m_full = false;
+
+            int const ready = poll(fds.data(), nfds_t(fds.size()), timeout);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                cerr << "poll: " << strerror(errno) << "\n";
+                break;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                accept_all();
+            }
+            if (fds[1].revents & POLLIN) {
+                answer();
+            }
+
+            // sessions accepted above are not in 'fds' yet and are polled next time
+            size_t const polled = fds.size() - 2;
+            for (size_t i=0; i < polled; ++i) {
+                Session &s = *m_sessions[i];
+                short const revents = fds[i + 2].revents;
+                bool keep = true;
+
+                if (s.fd < 0) {
+                    continue;
+                }
+                if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                    keep = receive(s);
+                }
+                if (keep && !s.out.empty()) {
+                    keep = send(s);
+                } else if (keep && s.closing) {
+                    keep = false;
+                }
+                if (!keep) {
+                    close(s.fd);
+                    s.fd = -1;
+                }
+            }
+
+            // drop closed sessions, once no search is using them
+            size_t live = 0;
+            for (size_t i=0; i < m_sessions.size(); ++i) {
+                if (m_sessions[i]->fd >= 0 || !m_sessions[i]->thinking.empty()) {
+                    if (live != i) m_sessions[live] = std::move(m_sessions[i]);
+                    live++;
+                }
+            }
+            m_sessions.resize(live);
+        }
+    } // Server::run()
+
+
+    void stop() { m_running = false; }
+    size_t sessions() const { return m_sessions.size(); }
+    size_t served() const { return m_served; }
+    size_t refused() const { return m_refused; }
+
+};  // class Server
+
+#endif /* server_h */
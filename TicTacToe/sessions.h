@@ -0,0 +1,420 @@
+///
+///  @file sessions.h
+///  @brief the declaration and definition of the SessionTask, SessionScheduler, Mailbox and GameSessions classes
+///
+
+#ifndef sessions_h
+#define sessions_h
+
+// sessions are C++20 coroutines; a C++17 build leaves them out
+#if defined(__cpp_impl_coroutine)
+#define HAVE_SESSIONS 1
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "move.h"
+#include "game.h"
+#include "stats.h"
+#include "threadpool.h"
+
+class SessionScheduler;
+
+/// @brief SessionTask is what a session coroutine returns.
+///
+/// A session is written as one straight function that plays its game and
+/// co_awaits wherever it would otherwise block: on a Mailbox for the
+/// other side's input, or on SessionScheduler::offload() for an engine
+/// move. Suspended, it costs only its coroutine frame (its locals, the
+/// game among them) and no thread. The frame frees itself when the
+/// session returns.
+///
+class SessionTask {
+public:
+    struct promise_type {
+        SessionScheduler   *scheduler = nullptr;
+
+        /// @returns the bytes held by every live session frame
+        static std::atomic<size_t> &frame_bytes() {
+            static std::atomic<size_t> bytes(0);
+            return bytes;
+        }
+
+        static void *operator new(size_t const size) {
+            frame_bytes().fetch_add(size, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+
+        static void operator delete(void *const frame, size_t const size) {
+            frame_bytes().fetch_sub(size, std::memory_order_relaxed);
+            ::operator delete(frame);
+        }
+
+        /// @brief free the frame, then tell the scheduler the session is over
+        struct Finish {
+            bool await_ready() const noexcept { return false; }
+            inline void await_suspend(std::coroutine_handle<promise_type> session) noexcept;
+            void await_resume() const noexcept {}
+        };
+
+        SessionTask get_return_object() {
+            return SessionTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }  // started by spawn()
+        Finish final_suspend() const noexcept { return {}; }
+        void return_void() const {}
+        void unhandled_exception() const { std::terminate(); }
+    };
+
+private:
+    friend class SessionScheduler;
+
+    std::coroutine_handle<promise_type> m_handle;
+
+    explicit SessionTask(std::coroutine_handle<promise_type> const handle) : m_handle(handle) {}
+
+public:
+    SessionTask(SessionTask &&rhs) noexcept : m_handle(std::exchange(rhs.m_handle, nullptr)) {}
+
+    SessionTask(SessionTask const &) = delete;
+    SessionTask &operator = (SessionTask const &) = delete;
+
+    /// @brief a session never spawned is dropped without running
+    ~SessionTask() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+};  // class SessionTask
+
+
+/// @brief SessionScheduler runs session coroutines on a WorkStealingPool.
+///
+/// Resuming a session is a task on the pool, so any number of sessions
+/// share the pool's few threads and a session picks up on whichever worker
+/// gets to it. A session is resumed when its Mailbox gets input or when
+/// the work it offloaded is done; the rest of the time it waits in memory.
+///
+class SessionScheduler {
+private:
+    WorkStealingPool            m_pool;
+    std::atomic<size_t>         m_live;         // sessions spawned and not yet finished
+    std::atomic<uint64_t>       m_resumes;
+    std::mutex                  m_idle_lock;
+    std::condition_variable     m_idle;         // signalled when the last session finishes
+
+public:
+    /// @brief run sessions on 'threads' workers (0: one per core)
+    explicit SessionScheduler(size_t const threads = 0) :
+        m_pool(threads),
+        m_live(0),
+        m_resumes(0) {
+    } // SessionScheduler::SessionScheduler(size_t const threads)
+
+
+    ~SessionScheduler() {
+        wait();
+    }
+
+
+    size_t threads() const { return m_pool.size(); }
+    size_t live() const { return m_live.load(); }
+    uint64_t resumes() const { return m_resumes.load(std::memory_order_relaxed); }
+
+
+    /// @name resume(std::coroutine_handle<> session)
+    /// @brief queue a suspended session to carry on on the pool
+    void resume(std::coroutine_handle<> const session) {
+        m_resumes.fetch_add(1, std::memory_order_relaxed);
+        m_pool.submit([session] { session.resume(); });
+    } // SessionScheduler::resume(std::coroutine_handle<> session)
+
+
+    /// @name spawn(SessionTask task)
+    /// @brief start a session; it runs until its first co_await on the pool
+    void spawn(SessionTask task) {
+        std::coroutine_handle<SessionTask::promise_type> const session = std::exchange(task.m_handle, nullptr);
+        session.promise().scheduler = this;
+        m_live.fetch_add(1);
+        resume(session);
+    } // SessionScheduler::spawn(SessionTask task)
+
+
+    /// @brief called by a finishing session once its frame is freed
+    void finished() {
+        if (m_live.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> guard(m_idle_lock);
+            m_idle.notify_all();
+        }
+    } // SessionScheduler::finished()
+
+
+    /// @name wait()
+    /// @brief block until every spawned session has finished
+    void wait() {
+        std::unique_lock<std::mutex> guard(m_idle_lock);
+        m_idle.wait(guard, [this] { return m_live.load() == 0; });
+    } // SessionScheduler::wait()
+
+
+    /// @name offload(F work)
+    /// @brief co_await to run 'work' (an engine search, say) as a task of
+    /// its own and resume with its result, so a long search doesn't hold
+    /// up the sessions queued behind this one on the same worker
+    template <typename F>
+    auto offload(F work) {
+        typedef decltype(work()) result_t;
+
+        struct Offload {
+            SessionScheduler           &scheduler;
+            F                           work;
+            result_t                    result {};
+
+            bool await_ready() const { return false; }
+            void await_suspend(std::coroutine_handle<> const session) {
+                scheduler.m_resumes.fetch_add(1, std::memory_order_relaxed);
+                scheduler.m_pool.submit([this, session] {
+                    result = work();
+                    session.resume();
+                });
+            }
+            result_t await_resume() { return std::move(result); }
+        };
+        return Offload { *this, std::move(work) };
+    } // SessionScheduler::offload(F work)
+
+
+    /// @name yield()
+    /// @brief co_await to let the other sessions queued on this worker run first
+    auto yield() {
+        struct Yield {
+            SessionScheduler   &scheduler;
+
+            bool await_ready() const { return false; }
+            void await_suspend(std::coroutine_handle<> const session) { scheduler.resume(session); }
+            void await_resume() const {}
+        };
+        return Yield { *this };
+    } // SessionScheduler::yield()
+
+};  // class SessionScheduler
+
+
+inline void SessionTask::promise_type::Finish::await_suspend(std::coroutine_handle<promise_type> const session) noexcept {
+    SessionScheduler *const scheduler = session.promise().scheduler;
+    session.destroy();
+    if (scheduler) {
+        scheduler->finished();
+    }
+} // SessionTask::promise_type::Finish::await_suspend(...)
+
+
+/// @brief Mailbox passes values to one session from any thread.
+///
+/// deliver() queues a value and, if the session is waiting on next(),
+/// resumes it on its SessionScheduler. A session that asks for its next
+/// value when one is already queued goes on without suspending.
+///
+template <typename T>
+class Mailbox {
+private:
+    SessionScheduler           &m_scheduler;
+    std::mutex                  m_lock;         // guards the members below
+    std::deque<T>               m_values;
+    std::coroutine_handle<>     m_waiter;       // the session waiting in next(), if any
+
+public:
+    explicit Mailbox(SessionScheduler &scheduler) : m_scheduler(scheduler) {}
+
+    Mailbox(Mailbox const &) = delete;
+    Mailbox &operator = (Mailbox const &) = delete;
+
+
+    /// @name deliver(T value)
+    /// @brief queue 'value' for the session and wake it if it is waiting
+    void deliver(T value) {
+        std::coroutine_handle<> waiter;
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_values.push_back(std::move(value));
+            std::swap(waiter, m_waiter);
+        }
+        if (waiter) {
+            m_scheduler.resume(waiter);
+        }
+    } // Mailbox::deliver(T value)
+
+
+    /// @name next()
+    /// @brief co_await for the next value delivered
+    auto next() {
+        struct Next {
+            Mailbox    &box;
+
+            bool await_ready() {
+                std::lock_guard<std::mutex> guard(box.m_lock);
+                return !box.m_values.empty();
+            }
+            bool await_suspend(std::coroutine_handle<> const session) {
+                // a value may have come since await_ready(): then don't suspend
+                std::lock_guard<std::mutex> guard(box.m_lock);
+                if (!box.m_values.empty()) {
+                    return false;
+                }
+                box.m_waiter = session;
+                return true;
+            }
+            T await_resume() {
+                std::lock_guard<std::mutex> guard(box.m_lock);
+                T value = std::move(box.m_values.front());
+                box.m_values.pop_front();
+                return value;
+            }
+        };
+        return Next { *this };
+    } // Mailbox::next()
+
+};  // class Mailbox
+
+
+/// @brief GameSessions hosts any number of games at once, each a session
+/// coroutine on a SessionScheduler, against simulated clients.
+///
+/// A session plays the engine as O against a client playing X: it asks
+/// the clients for X's move and waits on its Mailbox, then offloads the
+/// engine's reply, until the game ends. The clients are the thread that
+/// calls run(), standing in for a server's I/O thread: it answers each
+/// request with a random legal cell and delivers it to the session's
+/// Mailbox, so every session is woken from another thread as it would be
+/// by a network client.
+///
+class GameSessions {
+private:
+    /// @brief a session waiting for its client's move
+    struct Request {
+        Mailbox<int>           *inbox;
+        InARowGame const       *game;
+    };
+
+    SessionScheduler            m_scheduler;
+    std::mutex                  m_lock;         // guards m_requests
+    std::condition_variable     m_wake;
+    vector<Request>             m_requests;
+    std::atomic<uint64_t>       m_results[3];   // draws, O wins, X wins: indexed like a WINNER Move's value
+    std::atomic<uint64_t>       m_moves;
+    size_t                      m_frame;        // bytes in one session's coroutine frame
+    GameStats                  *m_stats;        // where finished games are tallied, if anywhere
+
+    /// @brief ask the clients for X's move in 'game'
+    void ask(Mailbox<int> &inbox, InARowGame const &game) {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_requests.push_back({ &inbox, &game });
+        }
+        m_wake.notify_one();
+    } // GameSessions::ask(Mailbox<int> &inbox, InARowGame const &game)
+
+
+    /// @returns a random cell a piece can be placed on
+    static int choose(InARowGame const &game, Rng &rng) {
+        int open = 0;
+        for (int n=0; n < game.m_cells; ++n) {
+            open += game.playable(n);
+        }
+        for (int n=0, pick=int(rng.below(uint32_t(open))); n < game.m_cells; ++n) {
+            if (game.playable(n) && pick-- == 0) {
+                return n;
+            }
+        }
+        return -1;
+    } // GameSessions::choose(InARowGame const &game, Rng &rng)
+
+
+    /// @name session()
+    /// @brief play one game, suspended whenever it waits on the client or the engine
+    SessionTask session() {
+        InARowGame game(Grid, Base);
+        Mailbox<int> inbox(m_scheduler);
+        Move result;
+
+        for (int turn=1; turn <= game.m_cells; ++turn) {
+            Move move;
+            if (turn & 1) {
+                ask(inbox, game);
+                move = Move(FORCED, co_await inbox.next());
+            } else {
+                move = co_await m_scheduler.offload([&game] { return game.think(); });
+            }
+            result = game.process(turn & 1, move);
+            m_moves.fetch_add(1, std::memory_order_relaxed);
+            if (result.key == NOMOVE || result.key == WINNER) {
+                break;
+            }
+        }
+
+        m_results[result.key == WINNER ? result.value : 0].fetch_add(1, std::memory_order_relaxed);
+        if (m_stats) {
+            m_stats->record(game, result);
+        }
+    } // GameSessions::session()
+
+public:
+    /// @brief run sessions on 'threads' workers (0: one per core), tallying games in 'stats' if given
+    explicit GameSessions(size_t const threads = 0, GameStats *const stats = nullptr) :
+        m_scheduler(threads),
+        m_results { {0}, {0}, {0} },
+        m_moves(0),
+        m_frame(0),
+        m_stats(stats) {
+    } // GameSessions::GameSessions(size_t const threads, GameStats *const stats)
+
+
+    SessionScheduler const &scheduler() const { return m_scheduler; }
+    uint64_t results(int const outcome) const { return m_results[outcome].load(); }
+    uint64_t moves() const { return m_moves.load(); }
+    size_t frame() const { return m_frame; }
+
+
+    /// @name run(uint64_t const sessions)
+    /// @brief start 'sessions' games at once and be their clients until every one is over
+    void run(uint64_t const sessions) {
+        size_t const before = SessionTask::promise_type::frame_bytes().load();
+        for (uint64_t s=0; s < sessions; ++s) {
+            m_scheduler.spawn(session());
+        }
+        // no session can finish before its client's first move
+        m_frame = sessions ? (SessionTask::promise_type::frame_bytes().load() - before) / size_t(sessions) : 0;
+
+        Rng rng(ThreadRng.next());
+        vector<Request> batch;
+        while (m_scheduler.live() > 0) {
+            {
+                std::unique_lock<std::mutex> guard(m_lock);
+                m_wake.wait_for(guard, std::chrono::milliseconds(10), [this] { return !m_requests.empty(); });
+                batch.swap(m_requests);
+            }
+            for (Request const &r : batch) {
+                r.inbox->deliver(choose(*r.game, rng));
+            }
+            batch.clear();
+        }
+        m_scheduler.wait();
+    } // GameSessions::run(uint64_t const sessions)
+
+};  // class GameSessions
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* sessions_h */
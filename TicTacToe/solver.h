@@ -0,0 +1,500 @@
+///
+///  @file solver.h
+///  @brief the declaration and definition of the Solver class
+///
+
+#ifndef solver_h
+#define solver_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include <iostream>
+using std::cout;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "line.h"
+#include "game.h"
+#include "timecontrol.h"
+
+/// @brief Solver proves the game-theoretic value of an InARowGame position
+/// with depth-first proof-number search (df-pn).
+///
+/// A df-pn run proves or disproves "the attacker wins". The Solver first
+/// tries to prove that 'X' wins, then that 'O' wins; if neither holds the
+/// position is a draw.
+///
+/// Positions are classified from the Line patterns:
+///
+///     - a Line of Base pieces ends the game
+///     - the side to move with a FORCED Line of its own wins
+///     - the side to move facing two different FORCED cells loses
+///     - the side to move facing one FORCED cell has that one move
+///     - a position where no Line can still be won is a draw
+///     - otherwise the open cells of Lines that can still be won are the
+///       moves; any other cell is no better than passing
+///     - in a gravity game threats above the lowest open cell of their
+///       column wait and every column is a move
+///
+/// Proof and disproof numbers are kept in a fixed size transposition table
+/// keyed by the game's Zobrist hash. Each bucket holds two entries and a
+/// new entry replaces the one that took the least work to compute, so
+/// memory stays bounded however long the search runs. The table and the
+/// counters can be written to a checkpoint file periodically and loaded
+/// again to resume a run.
+///
+class Solver {
+public:
+    static uint32_t constexpr Infinity = 0x7fffffff;
+
+    typedef enum { UNKNOWN, XWINS, OWINS, DRAW } value_e;
+
+    /// @brief a transposition table entry
+    struct Entry {
+        uint64_t key;
+        uint32_t pn;        // proof number
+        uint32_t dn;        // disproof number
+        uint32_t work;      // nodes searched to compute pn/dn
+        uint32_t pad;
+    };
+
+private:
+    // checkpoint files begin with this; changed whenever their header does
+    static uint64_t constexpr CheckpointMagic = 0x4e50464449524f58ull;
+
+    InARowGame             &m_game;
+    vector<Entry>           m_table;        // 2 entries per bucket
+    uint64_t                m_mask;         // bucket index mask
+    int                     m_attacker;     // piece (1 or 2) trying to win in this run
+    uint64_t                m_salt;         // keeps the two runs' entries apart
+    uint64_t                m_nodes;        // nodes searched, over both runs
+    uint64_t                m_proven;       // positions proven
+    uint64_t                m_disproven;    // positions disproven
+    std::atomic<bool>      *m_stop;         // set to stop the search (e.g. on SIGINT)
+    bool                    m_stopped;
+
+    // periodic reporting and checkpoints
+    string                  m_checkpoint;   // checkpoint file; empty for none
+    double                  m_interval;     // seconds between checkpoints
+    steady_clock::time_point m_start;
+    steady_clock::time_point m_last;
+    uint64_t                m_last_nodes;
+
+    static inline uint32_t sum(uint32_t const a, uint32_t const b) {
+        return (a >= Infinity - b) ? Infinity : a + b;
+    }
+
+
+    /// @name lookup(uint64_t const key, uint32_t &pn, uint32_t &dn) const
+    /// @returns true if the position is in the table
+    bool lookup(uint64_t const key, uint32_t &pn, uint32_t &dn) const {
+        size_t const bucket = (key & m_mask) * 2;
+        for (size_t i=bucket; i < bucket + 2; ++i) {
+            if (m_table[i].key == key && (m_table[i].pn | m_table[i].dn)) {
+                pn = m_table[i].pn;
+                dn = m_table[i].dn;
+                return true;
+            }
+        }
+        return false;
+    } // Solver::lookup(...)
+
+
+    /// @name store(uint64_t const key, uint32_t const pn, uint32_t const dn, uint32_t const work)
+    /// @brief save a result, replacing the cheaper entry of the bucket
+    void store(uint64_t const key, uint32_t const pn, uint32_t const dn, uint32_t const work) {
+        size_t const bucket = (key & m_mask) * 2;
+        Entry *slot = nullptr;
+
+        for (size_t i=bucket; i < bucket + 2; ++i) {
+            if (m_table[i].key == key) {
+                slot = &m_table[i];
+                break;
+            }
+        }
+        if (slot == nullptr) {
+            Entry &a = m_table[bucket];
+            Entry &b = m_table[bucket + 1];
+            slot = (a.work <= b.work) ? &a : &b;
+        }
+
+        bool const was_proven = slot->key == key && slot->pn == 0;
+        bool const was_disproven = slot->key == key && slot->dn == 0;
+        if (pn == 0 && !was_proven) m_proven++;
+        if (dn == 0 && !was_disproven) m_disproven++;
+
+        slot->key = key;
+        slot->pn = pn;
+        slot->dn = dn;
+        slot->work = std::max(work, (slot->key == key) ? slot->work : 0u);
+    } // Solver::store(...)
+
+
+    /// @name mover() const
+    /// @returns the piece to move: 'X' (2) moves first
+    int mover() const {
+        int filled = 0;
+        for (int const c : m_game.m_board) {
+            filled += (c != 0);
+        }
+        return (filled & 1) ? 1 : 2;
+    } // Solver::mover()
+
+
+    /// @name classify(int const mover, vector<int> &moves, uint32_t &pn, uint32_t &dn) const
+    /// @brief decide a position from its Line patterns or list its moves
+    /// @returns true if the position is decided and pn/dn were set
+    bool classify(int const mover, vector<int> &moves, uint32_t &pn, uint32_t &dn) const {
+        int block = -1;
+        int winner = 0;
+        bool live = false;
+        vector<bool> wanted(m_game.m_board.size(), false);
+
+        moves.clear();
+
+        for (int const n : m_game.m_active) {
+            Line const line = m_game.m_lines[n];
+            Pattern const p = line.pattern();
+
+            if (p.key == WINNER) {
+                winner = p.owner;
+                break;
+            }
+
+            if (p.key == FORCED) {
+                int const cell = line.cell(line.m_length <= 16 ? p.first() : line.open_cells()[0]);
+                live = true;
+                if (!m_game.playable(cell)) {
+                    // a gravity threat that can't be played yet
+                    continue;
+                }
+                if (p.owner == mover) {
+                    winner = mover;
+                    break;
+                }
+                if (block >= 0 && block != cell) {
+                    // two threats; the side to move loses unless it wins first
+                    winner = -(3 - mover);
+                }
+                block = cell;
+            } else if (p.key == RANDOM1) {
+                live = true;
+                if (line.m_length <= 16) {
+                    for (uint32_t bits = p.open; bits; bits &= bits - 1) {
+                        wanted[line.cell(__builtin_ctz(bits))] = true;
+                    }
+                } else {
+                    for (int const i : line.open_cells()) {
+                        wanted[line.cell(i)] = true;
+                    }
+                }
+            }
+        }
+
+        if (winner < 0) {
+            winner = -winner;
+        }
+
+        if (winner == 0 && !live) {
+            // nobody can win any more; not a win for the attacker
+            pn = Infinity;
+            dn = 0;
+            return true;
+        }
+
+        if (winner != 0) {
+            pn = (winner == m_attacker) ? 0 : Infinity;
+            dn = (winner == m_attacker) ? Infinity : 0;
+            return true;
+        }
+
+        if (block >= 0) {
+            moves.push_back(block);
+            return false;
+        }
+
+        for (size_t n=0; n < wanted.size(); ++n) {
+            if (wanted[n] && !m_game.m_gravity) {
+                moves.push_back(int(n));
+            }
+        }
+
+        // under gravity a move changes which cells can be reached, so no
+        // column is ever as good as passing
+        for (int c=0; m_game.m_gravity && c < m_game.m_grid; ++c) {
+            if (m_game.drop(c) >= 0) {
+                moves.push_back(m_game.drop(c));
+            }
+        }
+
+        return false;
+    } // Solver::classify(...)
+
+
+    /// @name child(int const cell, int const piece, uint32_t &pn, uint32_t &dn)
+    /// @brief the current proof numbers of the position after a move
+    void child(int const cell, int const piece, uint32_t &pn, uint32_t &dn) {
+        m_game.place(cell, piece);
+        if (!lookup(m_game.m_hash ^ m_salt, pn, dn)) {
+            pn = 1;
+            dn = 1;
+        }
+        m_game.unplace(cell);
+    } // Solver::child(...)
+
+
+    /// @name mid(uint32_t const thpn, uint32_t const thdn)
+    /// @brief expand the current position until its proof or disproof
+    /// number reaches its threshold
+    /// @returns the nodes searched
+    uint32_t mid(uint32_t const thpn, uint32_t const thdn) {
+        uint64_t const key = m_game.m_hash ^ m_salt;
+        uint64_t const before = m_nodes;
+        int const side = mover();
+        bool const attacking = (side == m_attacker);
+        vector<int> moves;
+        uint32_t pn = 1, dn = 1;
+
+        m_nodes++;
+        poll();
+
+        if (classify(side, moves, pn, dn)) {
+            store(key, pn, dn, 1);
+            return 1;
+        }
+
+        while (!m_stopped) {
+            // gather the children's numbers and pick the most promising one
+            uint32_t best = Infinity, second = Infinity, total = 0;
+            uint32_t best_pn = 1, best_dn = 1;
+            int best_cell = -1;
+
+            for (int const cell : moves) {
+                uint32_t cpn, cdn;
+                child(cell, side, cpn, cdn);
+
+                uint32_t const pick = attacking ? cpn : cdn;
+                total = sum(total, attacking ? cdn : cpn);
+                if (best_cell < 0 || pick < best) {
+                    second = best;
+                    best = pick;
+                    best_cell = cell;
+                    best_pn = cpn;
+                    best_dn = cdn;
+                } else if (pick < second) {
+                    second = pick;
+                }
+            }
+
+            pn = attacking ? best : total;
+            dn = attacking ? total : best;
+
+            if (pn >= thpn || dn >= thdn || pn == 0 || dn == 0) {
+                break;
+            }
+
+            uint32_t cthpn, cthdn;
+            if (attacking) {
+                cthpn = std::min(thpn, sum(second, 1));
+                cthdn = sum(thdn - dn, best_dn);
+            } else {
+                cthdn = std::min(thdn, sum(second, 1));
+                cthpn = sum(thpn - pn, best_pn);
+            }
+
+            m_game.place(best_cell, side);
+            mid(cthpn, cthdn);
+            m_game.unplace(best_cell);
+        }
+
+        uint64_t const work = m_nodes - before;
+        store(key, pn, dn, uint32_t(std::min<uint64_t>(work, UINT32_MAX)));
+        return uint32_t(work);
+    } // Solver::mid(...)
+
+
+    /// @name poll()
+    /// @brief check for a stop request and report and checkpoint on schedule
+    void poll() {
+        if ((m_nodes & 0xfff) != 0) {
+            return;
+        }
+
+        if (m_stop && m_stop->load()) {
+            m_stopped = true;
+        }
+
+        auto const now = steady_clock::now();
+        if (std::chrono::duration<double>(now - m_last).count() >= m_interval) {
+            report(now);
+            if (!m_checkpoint.empty()) {
+                save(m_checkpoint);
+            }
+        }
+    } // Solver::poll()
+
+
+    void report(steady_clock::time_point const now) {
+        double const span = std::chrono::duration<double>(now - m_last).count();
+        double const total = std::chrono::duration<double>(now - m_start).count();
+        char buff[256];
+
+        snprintf(buff, sizeof(buff), "%.0fs  nodes %llu  proven %llu  disproven %llu  %.0f nodes/sec\n",
+            total, (unsigned long long) m_nodes, (unsigned long long) m_proven,
+            (unsigned long long) m_disproven, (m_nodes - m_last_nodes) / std::max(span, 1e-9));
+        cout << buff;
+        cout.flush();
+
+        m_last = now;
+        m_last_nodes = m_nodes;
+    } // Solver::report(...)
+
+
+    /// @name prove(int const attacker)
+    /// @returns 1 if 'attacker' wins, 0 if not, -1 if the search was stopped
+    int prove(int const attacker) {
+        m_attacker = attacker;
+        m_salt = (attacker == 2) ? 0 : 0x5bd1e9955bd1e995ull;
+
+        uint32_t pn = 1, dn = 1;
+        while (!m_stopped) {
+            if (lookup(m_game.m_hash ^ m_salt, pn, dn) && (pn == 0 || dn == 0)) {
+                break;
+            }
+            mid(Infinity - 1, Infinity - 1);
+        }
+
+        if (m_stopped) {
+            return -1;
+        }
+        return pn == 0 ? 1 : 0;
+    } // Solver::prove(int const attacker)
+
+
+public:
+    /// @name Solver(InARowGame &game, size_t const megabytes)
+    /// @param game      the position to solve; left unchanged
+    /// @param megabytes memory for the transposition table
+    Solver(InARowGame &game, size_t const megabytes = 256) :
+        m_game(game),
+        m_attacker(2),
+        m_salt(0),
+        m_nodes(0),
+        m_proven(0),
+        m_disproven(0),
+        m_stop(nullptr),
+        m_stopped(false),
+        m_interval(60.0),
+        m_last_nodes(0) {
+        size_t buckets = 1;
+        while (buckets * 2 * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) {
+            buckets *= 2;
+        }
+        m_table.assign(buckets * 2, Entry {});
+        m_mask = buckets - 1;
+        m_start = m_last = steady_clock::now();
+    } // Solver::Solver(InARowGame &game, size_t const megabytes)
+
+
+    /// @name set_checkpoint(string const &file, double const seconds)
+    /// @brief report progress and write a checkpoint every 'seconds'
+    void set_checkpoint(string const &file, double const seconds) {
+        m_checkpoint = file;
+        m_interval = seconds;
+    } // Solver::set_checkpoint(...)
+
+
+    void set_stop(std::atomic<bool> *stop) { m_stop = stop; }
+
+    uint64_t nodes() const { return m_nodes; }
+    uint64_t proven() const { return m_proven; }
+    uint64_t disproven() const { return m_disproven; }
+    size_t entries() const { return m_table.size(); }
+
+
+    /// @name solve()
+    /// @returns the game-theoretic value of the position, or UNKNOWN if stopped
+    value_e solve() {
+        int const x = prove(2);
+        if (x < 0) return UNKNOWN;
+        if (x > 0) return XWINS;
+
+        int const o = prove(1);
+        if (o < 0) return UNKNOWN;
+        if (o > 0) return OWINS;
+
+        return DRAW;
+    } // Solver::solve()
+
+
+    /// @returns the board as a checkpoint records it: the width, with the
+    /// dimensions beyond 2 in the high half and the top bit set for gravity,
+    /// whose proof numbers mean nothing to a game without it
+    uint64_t geometry() const {
+        return uint64_t(m_game.m_grid) | (uint64_t(m_game.m_dims - 2) << 32) | (uint64_t(m_game.m_gravity) << 63);
+    }
+
+
+    /// @name save(string const &file)
+    /// @brief write the table and counters to a checkpoint file
+    /// @returns true on success
+    bool save(string const &file) const {
+        string const temp = file + ".tmp";
+        FILE *fp = fopen(temp.c_str(), "wb");
+        if (fp == nullptr) {
+            return false;
+        }
+
+        uint64_t const header[6] { CheckpointMagic, geometry(), uint64_t(m_game.m_base),
+                                   m_nodes, m_proven, m_disproven };
+        bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+        uint64_t const size = m_table.size();
+        ok = ok && fwrite(&size, sizeof(size), 1, fp) == 1;
+        ok = ok && fwrite(m_table.data(), sizeof(Entry), m_table.size(), fp) == m_table.size();
+        ok = (fclose(fp) == 0) && ok;
+
+        // replace the old checkpoint only once the new one is complete
+        return ok && rename(temp.c_str(), file.c_str()) == 0;
+    } // Solver::save(string const &file)
+
+
+    /// @name load(string const &file)
+    /// @brief resume from a checkpoint written for the same geometry and table size
+    /// @returns true if the checkpoint was loaded
+    bool load(string const &file) {
+        FILE *fp = fopen(file.c_str(), "rb");
+        if (fp == nullptr) {
+            return false;
+        }
+
+        uint64_t header[6] {};
+        uint64_t size = 0;
+        bool ok = fread(header, sizeof(header), 1, fp) == 1 && fread(&size, sizeof(size), 1, fp) == 1;
+        ok = ok && header[0] == CheckpointMagic && header[1] == geometry()
+                && header[2] == uint64_t(m_game.m_base) && size == m_table.size();
+        ok = ok && fread(m_table.data(), sizeof(Entry), m_table.size(), fp) == m_table.size();
+        fclose(fp);
+
+        if (ok) {
+            m_nodes = m_last_nodes = header[3];
+            m_proven = header[4];
+            m_disproven = header[5];
+        } else {
+            m_table.assign(m_table.size(), Entry {});
+        }
+
+        return ok;
+    } // Solver::load(string const &file)
+
+};  // class Solver
+
+#endif /* solver_h */
@@ -0,0 +1,369 @@
+///
+///  @file sparse.h
+///  @brief the declaration and definition of the OpenHash and SparseGame classes
+///
+
+#ifndef sparse_h
+#define sparse_h
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+
+#include <iostream>
+using std::cout;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "pattern.h"
+
+/// @brief OpenHash is a compact open addressing hash map from 64 bit keys
+/// to small values.
+///
+/// Slots hold the key and value inline and collisions probe linearly, so a
+/// lookup usually touches one cache line. Erasing shifts the following
+/// entries of the probe run back instead of leaving tombstones, so the
+/// table never needs rebuilding however many stones come and go. The
+/// table doubles when it gets half full. ~0 is reserved as the empty key.
+///
+template<typename V>
+class OpenHash {
+public:
+    static uint64_t constexpr Empty = ~uint64_t(0);
+
+private:
+    struct Slot {
+        uint64_t    key;
+        V           value;
+    };
+
+    vector<Slot>    m_slots;
+    size_t          m_mask;
+    size_t          m_size;
+
+    static inline size_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return size_t(z ^ (z >> 31));
+    }
+
+    void grow() {
+        vector<Slot> old;
+        old.swap(m_slots);
+        m_slots.assign(old.size() * 2, Slot { Empty, V() });
+        m_mask = m_slots.size() - 1;
+        m_size = 0;
+        for (Slot const &s : old) {
+            if (s.key != Empty) {
+                insert(s.key) = s.value;
+            }
+        }
+    } // OpenHash::grow()
+
+public:
+    explicit OpenHash(size_t const capacity = 64) :
+        m_slots(std::max<size_t>(capacity, 4), Slot { Empty, V() }),
+        m_size(0) {
+        assert((m_slots.size() & (m_slots.size() - 1)) == 0);
+        m_mask = m_slots.size() - 1;
+    } // OpenHash::OpenHash(size_t const capacity)
+
+
+    size_t size() const { return m_size; }
+    size_t bytes() const { return m_slots.size() * sizeof(Slot); }
+
+
+    /// @returns the value for 'key' or nullptr
+    inline V *find(uint64_t const key) {
+        for (size_t i = mix(key) & m_mask; ; i = (i + 1) & m_mask) {
+            if (m_slots[i].key == key) return &m_slots[i].value;
+            if (m_slots[i].key == Empty) return nullptr;
+        }
+    }
+
+    inline V const *find(uint64_t const key) const {
+        return const_cast<OpenHash *>(this)->find(key);
+    }
+
+
+    /// @returns the value for 'key', inserting a default one if it is new
+    inline V &insert(uint64_t const key) {
+        if ((m_size + 1) * 2 > m_slots.size()) {
+            grow();
+        }
+        size_t i = mix(key) & m_mask;
+        for ( ; m_slots[i].key != Empty; i = (i + 1) & m_mask) {
+            if (m_slots[i].key == key) return m_slots[i].value;
+        }
+        m_slots[i].key = key;
+        m_slots[i].value = V();
+        m_size++;
+        return m_slots[i].value;
+    } // OpenHash::insert(uint64_t const key)
+
+
+    /// @name erase(uint64_t const key)
+    /// @brief remove 'key' and shift the rest of its probe run back into place
+    void erase(uint64_t const key) {
+        size_t i = mix(key) & m_mask;
+        while (m_slots[i].key != key) {
+            if (m_slots[i].key == Empty) return;
+            i = (i + 1) & m_mask;
+        }
+
+        for (size_t j = (i + 1) & m_mask; m_slots[j].key != Empty; j = (j + 1) & m_mask) {
+            size_t const home = mix(m_slots[j].key) & m_mask;
+            // move j back to the hole unless its home lies cyclically in (i, j]
+            bool const stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stays) {
+                m_slots[i] = m_slots[j];
+                i = j;
+            }
+        }
+        m_slots[i].key = Empty;
+        m_size--;
+    } // OpenHash::erase(uint64_t const key)
+
+
+    template<typename F>
+    void for_each(F const &f) const {
+        for (Slot const &s : m_slots) {
+            if (s.key != Empty) f(s.key, s.value);
+        }
+    }
+
+
+    void clear() {
+        if (m_size > 0) {
+            std::fill(m_slots.begin(), m_slots.end(), Slot { Empty, V() });
+            m_size = 0;
+        }
+    }
+
+};  // class OpenHash
+
+
+/// @brief SparseGame plays Base in a row on an unbounded board.
+///
+/// Only the stones are stored, in an OpenHash keyed by their coordinates.
+/// A Line (Base cells in one of the four directions) exists only while it
+/// holds a stone: placing a stone creates or updates the 4 * Base Lines
+/// through it and taking it back removes the ones left empty. Each Line
+/// keeps the same base-3 code as a board Line and is classified with the
+/// same Pattern tables, so memory and the cost of a move grow with the
+/// number of stones and never with the size of the board.
+///
+/// The engine is the one-ply rule set of InARowGame::score(): complete an
+/// own FORCED Line, else block the other side's, else take the open cell
+/// shared by the most Lines that can still be won.
+///
+class SparseGame {
+public:
+    /// @brief a cell, a chosen move, or a finished game's winner
+    struct Move {
+        movetype_e  key = ZERO;
+        int         x = 0;
+        int         y = 0;
+    };
+
+    static int constexpr Limit = 1 << 28;   // coordinates must stay within +/- Limit
+
+private:
+    struct LineState {
+        uint32_t    code;       // base-3 code of the Line's cells, first cell lowest
+        uint32_t    stones;
+    };
+
+    static int constexpr Dirs[4][2] { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } };
+
+    int const               m_base;
+    Pattern const          *m_patterns;     // pattern table for Lines of length m_base (or nullptr)
+    OpenHash<uint8_t>       m_cells;        // stone -> piece
+    OpenHash<LineState>     m_lines;        // (start cell, direction) -> Line
+    OpenHash<int>           m_weights;      // scratch for think()
+    vector<Move>            m_history;
+    int                     m_minx, m_maxx, m_miny, m_maxy;
+
+    static inline uint64_t key(int const x, int const y, int const dir = 0) {
+        return (uint64_t(uint32_t(x + Limit)) << 32) | (uint64_t(uint32_t(y + Limit)) << 2) | uint64_t(dir);
+    }
+
+    static inline void unkey(uint64_t const k, int &x, int &y, int &dir) {
+        x = int(k >> 32) - Limit;
+        y = int((k & 0xffffffffull) >> 2) - Limit;
+        dir = int(k & 3);
+    }
+
+    inline Pattern pattern(uint32_t const code) const {
+        return m_patterns ? m_patterns[code] : classify(code, m_base);
+    }
+
+
+public:
+    explicit SparseGame(int const base) :
+        m_base(base),
+        m_patterns(pattern_table(base)),
+        m_minx(0), m_maxx(-1), m_miny(0), m_maxy(-1) {
+        assert(base >= 1 && base <= MaxLineBase);
+    } // SparseGame::SparseGame(int const base)
+
+
+    int stones() const { return int(m_cells.size()); }
+    size_t lines() const { return m_lines.size(); }
+    size_t bytes() const { return m_cells.bytes() + m_lines.bytes() + m_weights.bytes(); }
+    vector<Move> const &history() const { return m_history; }
+
+
+    /// @returns the piece (0, 1 or 2) on a cell
+    int at(int const x, int const y) const {
+        uint8_t const *p = m_cells.find(key(x, y));
+        return p ? *p : 0;
+    }
+
+
+    /// @name place(int const x, int const y, int const piece)
+    /// @brief put a stone on an open cell and update the Lines through it
+    /// @returns true if the stone completes Base in a row
+    bool place(int const x, int const y, int const piece) {
+        assert(at(x, y) == 0 && x > -Limit && x < Limit && y > -Limit && y < Limit);
+        bool won = false;
+
+        m_cells.insert(key(x, y)) = uint8_t(piece);
+        for (int d=0; d < 4; ++d) {
+            for (int i=0; i < m_base; ++i) {
+                LineState &line = m_lines.insert(key(x - Dirs[d][0] * i, y - Dirs[d][1] * i, d));
+                line.code += uint32_t(piece) * Pow3[i];
+                line.stones++;
+                won = won || pattern(line.code).key == WINNER;
+            }
+        }
+
+        m_history.push_back(Move { FORCED, x, y });
+        if (m_maxx < m_minx) {
+            m_minx = m_maxx = x;
+            m_miny = m_maxy = y;
+        }
+        m_minx = std::min(m_minx, x);
+        m_maxx = std::max(m_maxx, x);
+        m_miny = std::min(m_miny, y);
+        m_maxy = std::max(m_maxy, y);
+
+        return won;
+    } // SparseGame::place(int const x, int const y, int const piece)
+
+
+    /// @name unplace()
+    /// @brief take back the last stone; Lines left empty are removed
+    void unplace() {
+        assert(!m_history.empty());
+        Move const last = m_history.back();
+        m_history.pop_back();
+
+        uint64_t const cell = key(last.x, last.y);
+        int const piece = *m_cells.find(cell);
+        m_cells.erase(cell);
+
+        for (int d=0; d < 4; ++d) {
+            for (int i=0; i < m_base; ++i) {
+                uint64_t const k = key(last.x - Dirs[d][0] * i, last.y - Dirs[d][1] * i, d);
+                LineState &line = *m_lines.find(k);
+                line.code -= uint32_t(piece) * Pow3[i];
+                if (--line.stones == 0) {
+                    m_lines.erase(k);
+                }
+            }
+        }
+    } // SparseGame::unplace()
+
+
+    /// @name think(int const mover)
+    /// @brief choose a move for 'mover' (piece 1 or 2)
+    /// @returns the Move; its key says why it was chosen
+    Move think(int const mover) {
+        Move block;
+        Move best;
+        int best_weight = 0;
+        int ties = 0;
+
+        if (m_history.empty()) {
+            return Move { RANDOM1, 0, 0 };
+        }
+
+        m_weights.clear();
+        m_lines.for_each([&](uint64_t const k, LineState const &line) {
+            Pattern const p = pattern(line.code);
+            int x, y, d;
+            unkey(k, x, y, d);
+
+            if (p.key == FORCED) {
+                int i = 0;
+                while ((line.code / Pow3[i]) % 3 != 0) {
+                    i++;
+                }
+                Move const m { FORCED, x + Dirs[d][0] * i, y + Dirs[d][1] * i };
+                if (p.owner == mover) {
+                    best = m;
+                    best_weight = INT_MAX;
+                } else {
+                    block = m;
+                }
+            } else if (p.key == RANDOM1 && best_weight != INT_MAX) {
+                for (int i=0; i < m_base; ++i) {
+                    if ((line.code / Pow3[i]) % 3 == 0) {
+                        m_weights.insert(key(x + Dirs[d][0] * i, y + Dirs[d][1] * i))++;
+                    }
+                }
+            }
+        });
+
+        if (best_weight == INT_MAX) {
+            return best;
+        }
+        if (block.key == FORCED) {
+            return block;
+        }
+
+        // the open cell on the most Lines; ties are broken at random
+        m_weights.for_each([&](uint64_t const k, int const weight) {
+            if (weight > best_weight) {
+                best_weight = weight;
+                ties = 1;
+            } else if (weight == best_weight) {
+                ties++;
+            } else {
+                return;
+            }
+            if (ThreadRng.below(uint32_t(ties)) == 0) {
+                int d;
+                unkey(k, best.x, best.y, d);
+            }
+        });
+        best.key = RANDOM1;
+
+        if (best_weight == 0) {
+            // every Line near the stones is blocked; start somewhere new
+            best.key = RANDOM2;
+            best.x = m_maxx + m_base;
+            best.y = m_maxy + m_base;
+        }
+
+        return best;
+    } // SparseGame::think(int const mover)
+
+
+    /// @name display() const
+    /// @brief show the smallest rectangle holding every stone
+    void display() const {
+        for (int y=m_miny; y <= m_maxy; ++y) {
+            for (int x=m_minx; x <= m_maxx; ++x) {
+                cout << ".OX"[at(x, y)] << (x < m_maxx ? " " : "\n");
+            }
+        }
+    } // SparseGame::display()
+
+};  // class SparseGame
+
+#endif /* sparse_h */
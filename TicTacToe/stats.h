@@ -0,0 +1,296 @@
+///
+///  @file stats.h
+///  @brief the declaration and definition of the GameStats class
+///
+
+#ifndef stats_h
+#define stats_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "move.h"
+#include "game.h"
+
+/// @brief GameStats gathers outcome statistics over any number of finished
+/// games played on any number of threads.
+///
+/// For every game it counts the outcome, the outcome by first move, the
+/// cells each side ended up holding, and which Line won. Each thread that
+/// records games gets its own shard of counters the first time it records
+/// one, so the hot path never shares a cache line or takes a lock. The
+/// counters are atomics only so another thread may read them: the owning
+/// thread adds with a relaxed load and store (a plain load and store, no
+/// locked instruction), and merge() sums every shard with relaxed loads,
+/// at the end of a run or while games are still being played.
+///
+class GameStats {
+public:
+    enum { DRAW, O_WINS, X_WINS, OUTCOMES };    // indexed like a WINNER Move's value
+
+    /// @brief merged counts
+    struct Tally {
+        uint64_t            games[OUTCOMES] {};
+        vector<uint64_t>    first;          // [cell * OUTCOMES + outcome]: games opened on the cell
+        vector<uint64_t>    occupancy;      // [cell * 2 + side]: games the cell ended held by X (0) or O (1)
+        vector<uint64_t>    winning;        // [line * 2 + side]: wins by X (0) or O (1) completing the Line
+    };
+
+private:
+    typedef std::atomic<uint64_t> counter_t;
+
+    struct Shard {
+        std::unique_ptr<counter_t[]>    counts;
+        size_t                          size;
+
+        explicit Shard(size_t const n) : counts(new counter_t[n]), size(n) {
+            for (size_t i=0; i < n; ++i) {
+                counts[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    int const                       m_cells;
+    int const                       m_lines;
+    uint64_t const                  m_id;           // tells this table's shards from any earlier one's
+    mutable std::mutex              m_lock;         // guards m_shards
+    vector<std::unique_ptr<Shard>>  m_shards;
+
+    // where each table starts in a shard
+    size_t games_at() const { return 0; }
+    size_t first_at() const { return OUTCOMES; }
+    size_t occupancy_at() const { return first_at() + size_t(m_cells) * OUTCOMES; }
+    size_t winning_at() const { return occupancy_at() + size_t(m_cells) * 2; }
+    size_t shard_size() const { return winning_at() + size_t(m_lines) * 2; }
+
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> ids(1);
+        return ids.fetch_add(1);
+    }
+
+    static inline void bump(counter_t &c) {
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+
+    /// @returns the calling thread's shard, made on its first call
+    counter_t *shard() {
+        struct Cached {
+            uint64_t    id = 0;
+            counter_t  *counts = nullptr;
+        };
+        static thread_local Cached cached;
+
+        if (cached.id != m_id) {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_shards.emplace_back(new Shard(shard_size()));
+            cached.id = m_id;
+            cached.counts = m_shards.back()->counts.get();
+        }
+        return cached.counts;
+    } // GameStats::shard()
+
+public:
+    GameStats(int const cells, int const lines) :
+        m_cells(cells),
+        m_lines(lines),
+        m_id(next_id()) {
+    } // GameStats::GameStats(int const cells, int const lines)
+
+
+    GameStats(GameStats const &) = delete;
+    GameStats &operator = (GameStats const &) = delete;
+
+
+    size_t shards() const {
+        std::lock_guard<std::mutex> guard(m_lock);
+        return m_shards.size();
+    }
+
+
+    /// @name record(InARowGame const &game, Move const &result)
+    /// @brief count a finished game: 'result' is its final WINNER or NOMOVE
+    void record(InARowGame const &game, Move const &result) {
+        counter_t *const counts = shard();
+        vector<Move> const &history = game.m_history;
+        int const outcome = (result.key == WINNER) ? result.value : DRAW;
+
+        bump(counts[games_at() + outcome]);
+        if (!history.empty()) {
+            bump(counts[first_at() + size_t(history[0].value) * OUTCOMES + outcome]);
+        }
+        for (size_t ply=0; ply < history.size(); ++ply) {
+            // X moves first
+            bump(counts[occupancy_at() + size_t(history[ply].value) * 2 + (ply & 1)]);
+        }
+        if (outcome != DRAW && game.m_lastmove >= 0) {
+            for (pair<int, int> const &entry : game.cell_lines(game.m_lastmove)) {
+                if (game.m_lines.pattern(entry.first).key == WINNER) {
+                    bump(counts[winning_at() + size_t(entry.first) * 2 + (outcome == X_WINS ? 0 : 1)]);
+                    break;
+                }
+            }
+        }
+    } // GameStats::record(InARowGame const &game, Move const &result)
+
+
+    /// @name counts() const
+    /// @returns the sum of every thread's counts so far, as one flat table
+    vector<uint64_t> counts() const {
+        vector<uint64_t> sum(shard_size(), 0);
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (std::unique_ptr<Shard> const &s : m_shards) {
+            for (size_t i=0; i < s->size; ++i) {
+                sum[i] += s->counts[i].load(std::memory_order_relaxed);
+            }
+        }
+        return sum;
+    } // GameStats::counts()
+
+
+    /// @name restore(vector<uint64_t> const &sum)
+    /// @brief add a table counts() returned (e.g. from a checkpoint) to the calling thread's shard
+    /// @returns false if the table was made for another geometry
+    bool restore(vector<uint64_t> const &sum) {
+        if (sum.size() != shard_size()) {
+            return false;
+        }
+        counter_t *const counts = shard();
+        for (size_t i=0; i < sum.size(); ++i) {
+            counts[i].store(counts[i].load(std::memory_order_relaxed) + sum[i], std::memory_order_relaxed);
+        }
+        return true;
+    } // GameStats::restore(vector<uint64_t> const &sum)
+
+
+    /// @name merge() const
+    /// @returns the sum of every thread's counts so far
+    Tally merge() const {
+        Tally t;
+        vector<uint64_t> const sum = counts();
+
+        for (int o=0; o < OUTCOMES; ++o) {
+            t.games[o] = sum[games_at() + o];
+        }
+        t.first.assign(sum.begin() + first_at(), sum.begin() + occupancy_at());
+        t.occupancy.assign(sum.begin() + occupancy_at(), sum.begin() + winning_at());
+        t.winning.assign(sum.begin() + winning_at(), sum.end());
+        return t;
+    } // GameStats::merge()
+
+
+    /// @returns a cell's name as the board legend shows it, or its index off a flat board
+    static string name(int const cell, InARowGame const &game) {
+        return game.m_dims == 2 ? coords(cell, game.m_grid) : itoa(cell);
+    }
+
+
+    /// @name summary(InARowGame const &game) const
+    /// @returns the headline numbers of the merged tables, a line each
+    string summary(InARowGame const &game) const {
+        Tally const t = merge();
+        string out;
+        char buff[160];
+        int best = -1, busiest = -1, line = -1;
+        double best_score = -1.0;
+        uint64_t most = 0, wins = 0;
+
+        for (int c=0; c < m_cells; ++c) {
+            uint64_t const *f = &t.first[size_t(c) * OUTCOMES];
+            uint64_t const games = f[DRAW] + f[O_WINS] + f[X_WINS];
+            double const score = games ? (f[X_WINS] + 0.5 * f[DRAW]) / games : -1.0;
+            if (score > best_score) {
+                best_score = score;
+                best = c;
+            }
+            uint64_t const held = t.occupancy[size_t(c) * 2] + t.occupancy[size_t(c) * 2 + 1];
+            if (held > most) {
+                most = held;
+                busiest = c;
+            }
+        }
+        for (int n=0; n < m_lines; ++n) {
+            if (t.winning[size_t(n) * 2] + t.winning[size_t(n) * 2 + 1] > wins) {
+                wins = t.winning[size_t(n) * 2] + t.winning[size_t(n) * 2 + 1];
+                line = n;
+            }
+        }
+
+        uint64_t const games = t.games[DRAW] + t.games[O_WINS] + t.games[X_WINS];
+        if (best >= 0) {
+            sprintf(buff, "Best first move for X: %s (scores %.3f)\n", name(best, game).c_str(), best_score);
+            out += buff;
+        }
+        if (busiest >= 0) {
+            sprintf(buff, "Busiest cell: %s (taken in %.1f%% of games)\n", name(busiest, game).c_str(), 100.0 * most / std::max<uint64_t>(games, 1));
+            out += buff;
+        }
+        if (line >= 0) {
+            Line const l = game.m_lines[line];
+            sprintf(buff, "Most common winning Line: %d from %s by %d (%.1f%% of wins)\n", line, name(l.m_offset, game).c_str(), l.m_delta,
+                    100.0 * wins / std::max<uint64_t>(t.games[O_WINS] + t.games[X_WINS], 1));
+            out += buff;
+        }
+        return out;
+    } // GameStats::summary(InARowGame const &game)
+
+
+    /// @name save(string const &file, InARowGame const &game) const
+    /// @brief write the merged tables as CSV sections, naming cells and Lines by 'game'
+    /// @returns false if the file can't be written
+    bool save(string const &file, InARowGame const &game) const {
+        Tally const t = merge();
+        FILE *out = fopen(file.c_str(), "w");
+        if (out == nullptr) {
+            return false;
+        }
+
+        fprintf(out, "# outcomes\noutcome,games\n");
+        fprintf(out, "x_wins,%llu\no_wins,%llu\ndraws,%llu\n", (unsigned long long) t.games[X_WINS],
+                (unsigned long long) t.games[O_WINS], (unsigned long long) t.games[DRAW]);
+
+        fprintf(out, "\n# first move\ncell,games,x_wins,o_wins,draws,x_score\n");
+        for (int c=0; c < m_cells; ++c) {
+            uint64_t const *f = &t.first[size_t(c) * OUTCOMES];
+            uint64_t const games = f[DRAW] + f[O_WINS] + f[X_WINS];
+            if (games > 0) {
+                fprintf(out, "%s,%llu,%llu,%llu,%llu,%.4f\n", name(c, game).c_str(),
+                        (unsigned long long) games, (unsigned long long) f[X_WINS], (unsigned long long) f[O_WINS],
+                        (unsigned long long) f[DRAW], (f[X_WINS] + 0.5 * f[DRAW]) / games);
+            }
+        }
+
+        fprintf(out, "\n# occupancy\ncell,x,o\n");
+        for (int c=0; c < m_cells; ++c) {
+            fprintf(out, "%s,%llu,%llu\n", name(c, game).c_str(),
+                    (unsigned long long) t.occupancy[size_t(c) * 2], (unsigned long long) t.occupancy[size_t(c) * 2 + 1]);
+        }
+
+        fprintf(out, "\n# winning lines\nline,first,delta,x_wins,o_wins\n");
+        for (int n=0; n < m_lines; ++n) {
+            uint64_t const x = t.winning[size_t(n) * 2];
+            uint64_t const o = t.winning[size_t(n) * 2 + 1];
+            if (x + o > 0) {
+                Line const line = game.m_lines[n];
+                fprintf(out, "%d,%s,%d,%llu,%llu\n", n, name(line.m_offset, game).c_str(),
+                        line.m_delta, (unsigned long long) x, (unsigned long long) o);
+            }
+        }
+
+        return fclose(out) == 0;
+    } // GameStats::save(string const &file, InARowGame const &game)
+
+};  // class GameStats
+
+#endif /* stats_h */
@@ -0,0 +1,184 @@
+///
+///  @file threadpool.h
+///  @brief the declaration and definition of the WorkStealingPool class
+///
+
+#ifndef threadpool_h
+#define threadpool_h
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <vector>
+using std::vector;
+
+/// @brief WorkStealingPool runs tasks on a fixed set of worker threads.
+///
+/// Every worker owns a deque of tasks. A worker takes its newest task from
+/// the back of its own deque (depth first, cache warm) and when it runs dry
+/// steals the oldest task from the front of another worker's deque (the
+/// biggest remaining piece of work). Tasks submitted from inside a task go
+/// to the submitting worker's own deque.
+///
+/// A worker with nothing to take sleeps until submit() counts a new task
+/// in m_queued, so an idle pool costs no CPU.
+///
+class WorkStealingPool {
+public:
+    typedef std::function<void()> task_t;
+
+private:
+    struct Worker {
+        std::deque<task_t>  tasks;
+        std::mutex          lock;
+    };
+
+    vector<std::unique_ptr<Worker>> m_workers;
+    vector<std::thread>             m_threads;
+    std::atomic<size_t>             m_pending;  // submitted but not finished
+    std::atomic<size_t>             m_queued;   // submitted but not yet taken; raised under m_idle_lock
+    std::atomic<size_t>             m_next;     // round robin target for outside submits
+    std::atomic<bool>               m_done;
+    std::mutex                      m_idle_lock;
+    std::condition_variable         m_work;     // signalled when there is new work or the pool is closing
+    std::condition_variable         m_idle;     // signalled when all work is done
+
+    /// @name current()
+    /// @returns the index of the calling worker in its pool or -1 on other threads
+    static int &current() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    static WorkStealingPool *&owner() {
+        static thread_local WorkStealingPool *pool = nullptr;
+        return pool;
+    }
+
+
+    /// @name take(size_t const self, task_t &task)
+    /// @brief pop our own newest task or steal another worker's oldest one
+    /// @returns true if 'task' was set
+    bool take(size_t const self, task_t &task) {
+        {
+            Worker &mine = *m_workers[self];
+            std::lock_guard<std::mutex> guard(mine.lock);
+            if (!mine.tasks.empty()) {
+                task = std::move(mine.tasks.back());
+                mine.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t i=1; i < m_workers.size(); ++i) {
+            Worker &victim = *m_workers[(self + i) % m_workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    } // WorkStealingPool::take(size_t const self, task_t &task)
+
+
+    void run(size_t const self) {
+        current() = int(self);
+        owner() = this;
+
+        task_t task;
+        while (!m_done.load()) {
+            if (take(self, task)) {
+                m_queued.fetch_sub(1);
+                task();
+                task = nullptr;
+                if (m_pending.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> guard(m_idle_lock);
+                    m_idle.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(m_idle_lock);
+            m_work.wait(guard, [this] { return m_done.load() || m_queued.load() > 0; });
+        }
+    } // WorkStealingPool::run(size_t const self)
+
+
+public:
+    /// @name WorkStealingPool(size_t threads)
+    /// @param threads the number of workers; 0 means one per hardware thread
+    explicit WorkStealingPool(size_t threads = 0) :
+        m_pending(0),
+        m_queued(0),
+        m_next(0),
+        m_done(false) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i=0; i < threads; ++i) {
+            m_workers.emplace_back(new Worker());
+        }
+        for (size_t i=0; i < threads; ++i) {
+            m_threads.emplace_back(&WorkStealingPool::run, this, i);
+        }
+    } // WorkStealingPool::WorkStealingPool(size_t threads)
+
+
+    ~WorkStealingPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> guard(m_idle_lock);
+            m_done = true;
+        }
+        m_work.notify_all();
+        for (std::thread &t : m_threads) {
+            t.join();
+        }
+    } // WorkStealingPool::~WorkStealingPool()
+
+
+    size_t size() const { return m_workers.size(); }
+
+
+    /// @name submit(task_t task)
+    /// @brief queue a task; from inside a task it goes on the caller's own deque
+    void submit(task_t task) {
+        size_t target = m_next.fetch_add(1) % m_workers.size();
+        if (owner() == this && current() >= 0) {
+            target = size_t(current());
+        }
+
+        // counted before it can be taken, so m_queued never drops below the tasks in the deques
+        m_pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> guard(m_idle_lock);
+            m_queued.fetch_add(1);
+        }
+        {
+            Worker &worker = *m_workers[target];
+            std::lock_guard<std::mutex> guard(worker.lock);
+            worker.tasks.push_back(std::move(task));
+        }
+        m_work.notify_one();
+    } // WorkStealingPool::submit(task_t task)
+
+
+    /// @name wait()
+    /// @brief block until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> guard(m_idle_lock);
+        m_idle.wait(guard, [this] { return m_pending.load() == 0; });
+    } // WorkStealingPool::wait()
+
+};  // class WorkStealingPool
+
+#endif /* threadpool_h */
@@ -0,0 +1,253 @@
+///
+///  @file timecontrol.h
+///  @brief the declaration and definition of the TimeControl and Deadline classes
+///
+
+#ifndef timecontrol_h
+#define timecontrol_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+#include "common.h"
+
+using steady_clock = std::chrono::steady_clock;
+
+/// @brief Deadline bounds a single move decision.
+///
+/// The search calls expired() once per node. The node budget is checked on
+/// every call but the clock and the stop flag are only read every
+/// (CheckMask + 1) nodes so the check stays cheap inside the search.
+///
+class Deadline {
+public:
+    static uint64_t constexpr CheckMask = 7;
+    static uint64_t constexpr Unlimited = UINT64_MAX;
+
+private:
+    steady_clock::time_point    m_start;
+    steady_clock::time_point    m_end;
+    bool                        m_timed;    // false when there is no time limit
+    uint64_t                    m_limit;    // node budget
+    uint64_t                    m_nodes;    // nodes searched so far
+    bool                        m_expired;
+    std::atomic<bool> const    *m_stop;     // optional external cancellation
+
+public:
+    /// @name Deadline(double const seconds, uint64_t const nodes, std::atomic<bool> const *stop)
+    /// @param seconds time allowed for this decision; 0 or less means no time limit
+    /// @param nodes   node budget for this decision
+    /// @param stop    optional flag that ends the search early when set
+    Deadline(double const seconds = 0.0, uint64_t const nodes = Unlimited, std::atomic<bool> const *stop = nullptr) :
+        m_start(steady_clock::now()),
+        m_timed(seconds > 0.0),
+        m_limit(nodes),
+        m_nodes(0),
+        m_expired(false),
+        m_stop(stop) {
+        m_end = m_start + std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(seconds));
+    } // Deadline::Deadline(...)
+
+
+    /// @name expired()
+    /// @brief count a node and see if the search must stop
+    /// @returns true once the budget is used up or the search was cancelled
+    inline bool expired() {
+        if (m_expired) {
+            return true;
+        }
+
+        if (++m_nodes >= m_limit) {
+            return m_expired = true;
+        }
+
+        if ((m_nodes & CheckMask) == 0) {
+            if (m_timed && steady_clock::now() >= m_end) {
+                m_expired = true;
+            } else if (m_stop && m_stop->load(std::memory_order_relaxed)) {
+                m_expired = true;
+            }
+        }
+
+        return m_expired;
+    } // Deadline::expired()
+
+
+    /// @name limited() const
+    /// @returns true if this Deadline bounds the search at all
+    bool limited() const {
+        return m_timed || m_limit != Unlimited || m_stop != nullptr;
+    } // Deadline::limited()
+
+
+    uint64_t nodes() const { return m_nodes; }
+
+    /// @name elapsed() const
+    /// @returns the seconds since this Deadline was started
+    double elapsed() const {
+        return std::chrono::duration<double>(steady_clock::now() - m_start).count();
+    } // Deadline::elapsed()
+
+};  // class Deadline
+
+
+/// @brief TimeControl hands out the budget for each engine move and keeps
+/// the game clocks and a histogram of move latencies.
+///
+///     Mode        Budget per move
+///     =======================================================================================
+///     UNLIMITED   None. The engine plays its one-ply move (InARowGame::think()).
+///     FIXEDTIME   A fixed number of seconds per move.
+///     GAMECLOCK   A share of the side's remaining clock plus most of the increment.
+///                 The increment is added to the clock after each move.
+///     NODEBUDGET  A fixed number of search nodes per move.
+///
+/// Latencies go into fixed log-scale buckets (Steps per doubling from one
+/// microsecond up) rather than a list, so a server or ponderer that runs for
+/// days keeps the same few kilobytes and percentile() stays as cheap as on
+/// the first move. A percentile is reported as its bucket's upper edge,
+/// about 9% high at worst; the maximum is kept exactly.
+///
+class TimeControl {
+public:
+    typedef enum { UNLIMITED, FIXEDTIME, GAMECLOCK, NODEBUDGET } mode_e;
+
+    // seconds held back from every timed budget for making the move itself
+    static double constexpr Margin = 0.002;
+
+    static int constexpr Steps = 8;                 // latency buckets per doubling
+    static int constexpr Buckets = 1 + Steps * 32;  // under 1us, then up to 2^32us (over an hour)
+
+private:
+    mode_e          m_mode;
+    double          m_movetime;     // seconds per move for FIXEDTIME
+    double          m_total;        // starting seconds per side for GAMECLOCK
+    double          m_increment;    // seconds added after each move for GAMECLOCK
+    uint64_t        m_nodes;        // node budget for NODEBUDGET
+    double          m_clock[2];     // remaining seconds for each side
+    uint64_t        m_latency[Buckets];     // moves decided per latency bucket
+    uint64_t        m_moves;        // moves decided
+    double          m_slowest;      // seconds taken by the slowest of them
+
+public:
+    TimeControl() :
+        m_mode(UNLIMITED),
+        m_movetime(0.0),
+        m_total(0.0),
+        m_increment(0.0),
+        m_nodes(Deadline::Unlimited),
+        m_clock{ 0.0, 0.0 },
+        m_latency{},
+        m_moves(0),
+        m_slowest(0.0) {
+    } // TimeControl::TimeControl()
+
+
+    /// @name set_movetime(double const seconds)
+    /// @brief use a fixed time per move
+    void set_movetime(double const seconds) {
+        m_mode = FIXEDTIME;
+        m_movetime = seconds;
+    } // TimeControl::set_movetime(double const seconds)
+
+
+    /// @name set_clock(double const seconds, double const increment)
+    /// @brief use a total game clock per side with an increment per move
+    void set_clock(double const seconds, double const increment) {
+        m_mode = GAMECLOCK;
+        m_total = seconds;
+        m_increment = increment;
+        new_game();
+    } // TimeControl::set_clock(double const seconds, double const increment)
+
+
+    /// @name set_nodes(uint64_t const nodes)
+    /// @brief use a fixed node budget per move
+    void set_nodes(uint64_t const nodes) {
+        m_mode = NODEBUDGET;
+        m_nodes = nodes;
+    } // TimeControl::set_nodes(uint64_t const nodes)
+
+
+    /// @name new_game()
+    /// @brief reset both sides' clocks
+    void new_game() {
+        m_clock[0] = m_clock[1] = m_total;
+    } // TimeControl::new_game()
+
+
+    mode_e mode() const { return m_mode; }
+    double clock(int const side) const { return m_clock[side]; }
+
+
+    /// @name start(int const side, int const moves_left, std::atomic<bool> const *stop)
+    /// @brief start the clock for a move
+    /// @param side       0 or 1; whose clock to use for GAMECLOCK
+    /// @param moves_left the most moves this side can still have to make
+    /// @param stop       optional cancellation flag for the search
+    /// @returns the Deadline for this move
+    Deadline start(int const side, int const moves_left, std::atomic<bool> const *stop = nullptr) const {
+        switch (m_mode) {
+            case FIXEDTIME:
+                return Deadline(std::max(m_movetime - Margin, 0.0005), Deadline::Unlimited, stop);
+
+            case GAMECLOCK: {
+                double const remaining = std::max(m_clock[side] - Margin, 0.0);
+                double budget = remaining / std::max(moves_left, 1) + m_increment * 0.8;
+                budget = std::min(budget, remaining * 0.5 + m_increment * 0.8);
+                return Deadline(std::max(budget, 0.0005), Deadline::Unlimited, stop);
+            }
+
+            case NODEBUDGET:
+                return Deadline(0.0, m_nodes, stop);
+
+            case UNLIMITED:
+            default:
+                return Deadline(0.0, Deadline::Unlimited, stop);
+        }
+    } // TimeControl::start(...)
+
+
+    /// @name finish(int const side, Deadline const &deadline)
+    /// @brief stop the clock for a move: charge the side and record the latency
+    void finish(int const side, Deadline const &deadline) {
+        double const used = deadline.elapsed();
+
+        if (m_mode == GAMECLOCK) {
+            m_clock[side] += m_increment - used;
+        }
+
+        double const micros = used * 1e6;
+        int const bucket = micros < 1.0 ? 0 : std::min(Buckets - 1, 1 + int(std::log2(micros) * Steps));
+        m_latency[bucket]++;
+        m_moves++;
+        m_slowest = std::max(m_slowest, used);
+    } // TimeControl::finish(int const side, Deadline const &deadline)
+
+
+    /// @name percentile(double const p) const
+    /// @param p the percentile from 0 to 100
+    /// @returns the move latency in seconds at that percentile
+    double percentile(double const p) const {
+        if (m_moves == 0) {
+            return 0.0;
+        }
+
+        uint64_t const rank = std::min(m_moves - 1, uint64_t(p / 100.0 * double(m_moves - 1) + 0.5));
+        uint64_t seen = 0;
+        int bucket = 0;
+        while ((seen += m_latency[bucket]) <= rank) {
+            bucket++;
+        }
+        return std::min(m_slowest, std::exp2(double(bucket) / Steps) * 1e-6);
+    } // TimeControl::percentile(double const p)
+
+
+    size_t moves() const { return size_t(m_moves); }
+
+};  // class TimeControl
+
+#endif /* timecontrol_h */
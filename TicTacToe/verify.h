@@ -0,0 +1,565 @@
+///
+///  @file verify.h
+///  @brief the declaration and definition of the Verifier class
+///
+
+#ifndef verify_h
+#define verify_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <sstream>
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include "common.h"
+#include "move.h"
+#include "line.h"
+#include "game.h"
+#include "gravity.h"
+#include "nnue.h"
+#include "sparse.h"
+
+/// @brief Verifier checks every fast evaluation path of an InARowGame
+/// against a plain reference that reads the board one cell at a time.
+///
+/// The reference knows nothing of Line codes, pattern tables, bitboards or
+/// accumulators. For each position it compares:
+///
+///     - every Line's incremental code and its Pattern and Line::evaluate()
+///       result with a count of the Line's cells
+///     - the list of Lines that can still be won with the Lines holding
+///       pieces of one side only
+///     - score() (the one-ply engine behind analyze()) with the same rules
+///       applied to the reference Lines: the move type, and the move among
+///       the moves those rules allow
+///     - the Zobrist hash, the packed Position and the candidate cells
+///       within the engine's radius with ones rebuilt from the board
+///     - the network accumulator, when weights are attached, with one
+///       built from scratch
+///     - GravityBoard's win test in gravity games and SparseGame's in flat
+///       ones, replaying the game's moves
+///
+/// The geometry (every Line and the per-cell index) is checked once by
+/// check_geometry(). Positions come from random games, which are
+/// checked again while their moves are taken back, and from walking every
+/// game from the empty board depth first. The first divergence stops the
+/// run and leaves the game on the position that showed it.
+///
+class Verifier {
+private:
+    /// @brief a Line as the reference sees it
+    struct Reference {
+        movetype_e  key = ZERO;     // after Pattern::resolve()
+        int         owner = 0;      // the only side with pieces on the Line, else 0
+        bool        dead = false;   // the Line holds pieces of both sides
+        vector<int> open;           // board indexes of the open cells, in Line order
+    };
+
+    InARowGame     &m_game;
+    uint64_t        m_positions;
+    string          m_error;
+
+
+    /// @returns true if a piece can go on 'cell', worked out from the board alone
+    bool playable(int const cell) const {
+        vector<int> const &board = m_game.m_board;
+        if (board[cell] != 0) {
+            return false;
+        }
+        int const below = cell + m_game.m_grid;
+        return !m_game.m_gravity || below >= m_game.m_cells || board[below] != 0;
+    } // Verifier::playable(int const cell)
+
+
+    /// @name candidates() const
+    /// @returns for each cell whether the engine may consider it: some piece
+    /// is within the game's radius along every axis (or there is no radius or
+    /// no piece), worked out from the board alone
+    vector<char> candidates() const {
+        vector<int> const &board = m_game.m_board;
+        int const cells = m_game.m_cells;
+        int const radius = m_game.m_radius;
+        vector<char> allowed(cells, 1);
+
+        vector<int> pieces;
+        for (int c=0; c < cells; ++c) {
+            if (board[c] != 0) {
+                pieces.push_back(c);
+            }
+        }
+        if (radius == 0 || pieces.empty()) {
+            return allowed;
+        }
+        for (int c=0; c < cells; ++c) {
+            allowed[c] = 0;
+            for (int const p : pieces) {
+                bool close = true;
+                for (int d=0, a=c, b=p; d < m_game.m_dims; ++d, a /= m_game.m_grid, b /= m_game.m_grid) {
+                    close = close && std::abs(a % m_game.m_grid - b % m_game.m_grid) <= radius;
+                }
+                if (close) {
+                    allowed[c] = 1;
+                    break;
+                }
+            }
+        }
+        return allowed;
+    } // Verifier::candidates()
+
+
+    /// @name reference(Line const &line) const
+    /// @returns the Line classified from the board cells it covers
+    Reference reference(Line const &line) const {
+        Reference r;
+        int num[3] {};
+
+        for (int i=0; i < line.m_length; ++i) {
+            int const piece = m_game.m_board[line.cell(i)];
+            num[piece]++;
+            if (piece == 0) {
+                r.open.push_back(line.cell(i));
+            }
+        }
+
+        int const length = line.m_length;
+        r.owner = (num[1] && num[2]) ? 0 : num[1] ? 1 : num[2] ? 2 : 0;
+        r.dead = num[1] && num[2];
+
+        if (num[1] == length || num[2] == length) {
+            r.key = WINNER;
+        } else if (num[1] && num[2]) {
+            r.key = num[0] == 0 ? NOMOVE : (m_game.m_grid - num[0] >= length) ? RANDOM1 : RANDOM2;
+        } else if (r.owner != 0 && num[0] == 1) {
+            r.key = FORCED;
+        } else {
+            r.key = RANDOM1;
+        }
+
+        return r;
+    } // Verifier::reference(Line const &line)
+
+
+    /// @returns false after recording 'what' as the divergence
+    bool fail(string const &what) {
+        m_error = what;
+        return false;
+    }
+
+
+    /// @name check_lines()
+    /// @brief compare every Line and the Pattern and Move made from it with the reference
+    bool check_lines() {
+        vector<int> const &board = m_game.m_board;
+
+        for (int n=0; n < int(m_game.m_lines.size()); ++n) {
+            Line const line = m_game.m_lines[n];
+            Reference const r = reference(line);
+            auto const where = [&]() { return "line " + std::to_string(n) + " " + line.to_string() + ": "; };
+
+            uint32_t code = 0;
+            for (int i=0; i < line.m_length; ++i) {
+                code += uint32_t(board[line.cell(i)]) * Pow3[i];
+            }
+            if (line.m_code != code) {
+                return fail(where() + "code " + std::to_string(line.m_code) + ", board says " + std::to_string(code));
+            }
+
+            Pattern const p = line.pattern();
+            if (p.resolve(m_game.m_grid, line.m_length) != r.key || p.empties != r.open.size()
+                    || ((r.key == RANDOM1 || r.key == FORCED) && p.owner != r.owner)) {
+                return fail(where() + "pattern " + Move(p.resolve(m_game.m_grid, line.m_length), p.owner).to_string(0)
+                          + ", reference " + Move(r.key, r.owner).to_string(0));
+            }
+
+            Move const m = line.evaluate();
+            bool same = m.key == r.key;
+            switch (r.key) {
+                case WINNER:
+                    same = same && m.value == r.owner && int(m.choices.size()) == line.m_length;
+                    break;
+                case FORCED:
+                    same = same && m.value == r.open[0];
+                    break;
+                case RANDOM1:
+                case RANDOM2:
+                    same = same && m.choices == r.open;
+                    break;
+                default:
+                    break;
+            }
+            if (!same) {
+                return fail(where() + "evaluate() " + m.to_string(1, m_game.m_grid)
+                          + ", reference " + Move(r.key, r.key == WINNER ? r.owner : r.open.empty() ? 0 : r.open[0], r.open).to_string(1, m_game.m_grid));
+            }
+        }
+
+        // the live list holds each Line that isn't dead exactly once, and m_slot knows where
+        vector<bool> listed(m_game.m_lines.size(), false);
+        for (int i=0; i < int(m_game.m_active.size()); ++i) {
+            int const n = m_game.m_active[i];
+            if (listed[n] || m_game.m_slot[n] != i) {
+                return fail("line " + std::to_string(n) + " is listed twice or out of its slot in the live Lines");
+            }
+            listed[n] = true;
+        }
+        for (int n=0; n < int(m_game.m_lines.size()); ++n) {
+            if (listed[n] == reference(m_game.m_lines[n]).dead) {
+                return fail("line " + std::to_string(n) + (listed[n] ? " is dead but listed as live" : " is live but missing from the live Lines"));
+            }
+        }
+
+        return true;
+    } // Verifier::check_lines()
+
+
+    /// @name check_score()
+    /// @brief compare the one-ply engine's choice with its rules applied to the reference Lines
+    bool check_score() {
+        int const cells = m_game.m_cells;
+        vector<char> const near = candidates();
+        vector<int> counts[2] { vector<int>(cells, 0), vector<int>(cells, 0) };
+        vector<int> forced;
+        movetype_e top = ZERO;
+        int winner = 0;
+        bool live = false;
+
+        for (int n=0; n < m_game.m_lines.size(); ++n) {
+            Line const line = m_game.m_lines[n];
+            Reference const r = reference(line);
+            if (r.dead) {
+                continue;
+            }
+            live = true;
+            switch (r.key) {
+                case WINNER:
+                    winner = r.owner;
+                    top = std::max(top, WINNER);
+                    break;
+                case FORCED:
+                    if (playable(r.open[0])) {
+                        forced.push_back(r.open[0]);
+                        top = std::max(top, FORCED);
+                    }
+                    break;
+                case RANDOM1:
+                case RANDOM2:
+                    for (int const c : r.open) {
+                        if (playable(c) && near[c]) {
+                            counts[r.key - RANDOM2][c]++;
+                            top = std::max(top, r.key);
+                        }
+                    }
+                    break;
+                default:
+                    top = std::max(top, r.key);
+                    break;
+            }
+        }
+
+        if (!live) {
+            // drawn as soon as no Line can be won
+            top = NOMOVE;
+        }
+        if (top == ZERO) {
+            for (int c=0; c < cells; ++c) {
+                if (playable(c)) {
+                    counts[0][c]++;
+                    top = RANDOM2;
+                }
+            }
+        }
+        if (top == ZERO) {
+            top = NOMOVE;
+        }
+
+        vector<int> allowed;
+        if (top == FORCED) {
+            allowed = forced;
+        } else if (top == RANDOM1 || top == RANDOM2) {
+            vector<int> const &count = counts[top - RANDOM2];
+            int const most = *std::max_element(count.begin(), count.end());
+            for (int c=0; c < cells; ++c) {
+                if (count[c] == most) {
+                    allowed.push_back(c);
+                }
+            }
+        }
+
+        Move const m = m_game.score();
+        bool same = m.key == top;
+        switch (top) {
+            case WINNER:
+                same = same && m.value == winner;
+                break;
+            case FORCED:
+                same = same && std::find(allowed.begin(), allowed.end(), m.value) != allowed.end();
+                break;
+            case RANDOM1:
+            case RANDOM2:
+                same = same && m.choices == allowed && std::find(allowed.begin(), allowed.end(), m.value) != allowed.end();
+                break;
+            default:
+                break;
+        }
+        if (!same) {
+            return fail("score() " + m.to_string(1, m_game.m_grid) + ", reference "
+                      + Move(top, top == WINNER ? winner : allowed.empty() ? 0 : allowed[0], allowed).to_string(1, m_game.m_grid));
+        }
+
+        return true;
+    } // Verifier::check_score()
+
+
+    /// @name check_state()
+    /// @brief compare the hash, packed position, candidate cells and network
+    /// accumulator with fresh ones
+    bool check_state() {
+        vector<int> const &board = m_game.m_board;
+
+        uint64_t hash = 0;
+        for (int c=0; c < m_game.m_cells; ++c) {
+            if (board[c] != 0) {
+                hash ^= InARowGame::zobrist(c, board[c]);
+            }
+        }
+        if (m_game.m_hash != hash) {
+            return fail("hash differs from the board's");
+        }
+
+        if (!(m_game.state() == Position(board))) {
+            return fail("packed position " + m_game.state().to_string(InARowGame::m_dispPieces) + " differs from the board");
+        }
+
+        vector<char> const near = candidates();
+        for (int c=0; c < m_game.m_cells; ++c) {
+            if (board[c] == 0 && m_game.candidate(c) != bool(near[c])) {
+                return fail("cell " + std::to_string(c) + (near[c] ? " is near a piece but not a candidate" : " is a candidate but no piece is near"));
+            }
+        }
+
+        if (m_game.m_nnue.active()) {
+            NnueAccumulator fresh;
+            fresh.attach(m_game.m_nnue.weights(), m_game);
+            if (fresh.evaluate() != m_game.m_nnue.evaluate()) {
+                return fail("network " + std::to_string(m_game.m_nnue.evaluate()) + ", from scratch " + std::to_string(fresh.evaluate()));
+            }
+        }
+
+        return true;
+    } // Verifier::check_state()
+
+
+    /// @name check_boards()
+    /// @brief replay the game on the bitboard or sparse board and compare their win tests
+    bool check_boards() {
+        int winner = 0;
+        for (int n=0; n < m_game.m_lines.size(); ++n) {
+            Line const line = m_game.m_lines[n];
+            Reference const r = reference(line);
+            winner = (r.key == WINNER) ? r.owner : winner;
+        }
+
+        if (m_game.m_gravity && GravityBoard::fits(m_game.m_grid, m_game.m_grid)) {
+            GravityBoard bits(m_game.m_grid, m_game.m_grid, m_game.m_base);
+            for (Move const &m : m_game.m_history) {
+                bits.play(m.value % m_game.m_grid, m_game.m_board[m.value]);
+            }
+            for (int piece=1; piece <= 2; ++piece) {
+                if (bits.won(piece) != (winner == piece)) {
+                    return fail(string("GravityBoard says ") + InARowGame::m_dispPieces[piece] + (bits.won(piece) ? " won" : " didn't win"));
+                }
+            }
+        } else if (!m_game.m_gravity && m_game.m_dims == 2) {
+            SparseGame sparse(m_game.m_base);
+            bool won = false;
+            for (Move const &m : m_game.m_history) {
+                if (won) {
+                    return fail("SparseGame says the game was won before its last move");
+                }
+                won = sparse.place(m.value % m_game.m_grid, m.value / m_game.m_grid, m_game.m_board[m.value]);
+            }
+            if (won != (winner != 0)) {
+                return fail(string("SparseGame says the last move ") + (won ? "won" : "didn't win"));
+            }
+        }
+
+        return true;
+    } // Verifier::check_boards()
+
+
+    /// @returns true if the reference says the game is over
+    bool over() const {
+        for (int n=0; n < m_game.m_lines.size(); ++n) {
+            Line const line = m_game.m_lines[n];
+            if (reference(line).key == WINNER) {
+                return true;
+            }
+        }
+        return std::find(m_game.m_board.begin(), m_game.m_board.end(), 0) == m_game.m_board.end();
+    } // Verifier::over()
+
+
+    /// @brief make the move at 'cell' for the side whose turn it is
+    void play(int const cell) {
+        int const ply = int(m_game.m_history.size());
+        m_game.make_move(Move(FORCED, cell), (ply & 1) ? 0 : 1, false);
+    }
+
+
+    /// @name walk(uint64_t const limit)
+    /// @brief check this position and every game on from it, depth first
+    bool walk(uint64_t const limit) {
+        if (!check()) {
+            return false;
+        }
+        if (over()) {
+            return true;
+        }
+        for (int c=0; c < m_game.m_cells && m_positions < limit; ++c) {
+            if (playable(c)) {
+                play(c);
+                if (!walk(limit)) {
+                    return false;
+                }
+                m_game.unmake_move();
+            }
+        }
+        return true;
+    } // Verifier::walk(uint64_t const limit)
+
+
+public:
+    explicit Verifier(InARowGame &game) : m_game(game), m_positions(0) {}
+
+    uint64_t positions() const { return m_positions; }
+
+    /// @returns the first divergence found, or "" if there was none
+    string const &error() const { return m_error; }
+
+
+    /// @name check_geometry()
+    /// @brief check the Lines and the per-cell index against the board size:
+    /// each Line is base cells in a straight line, there are as many as the
+    /// (3^N - 1) / 2 directions allow, and each cell lists the Lines through it
+    bool check_geometry() {
+        int const grid = m_game.m_grid;
+        int const base = m_game.m_base;
+
+        // a step of 0 along an axis leaves grid places to start, +1 or -1 leaves grid - base + 1
+        double const expected = (std::pow(double(grid + 2 * (grid - base + 1)), m_game.m_dims) - std::pow(double(grid), m_game.m_dims)) / 2;
+        if (double(m_game.m_lines.size()) != expected) {
+            return fail("made " + std::to_string(m_game.m_lines.size()) + " Lines, expected " + std::to_string(int64_t(expected)));
+        }
+
+        vector<int> through(m_game.m_cells, 0);
+        for (int n=0; n < int(m_game.m_lines.size()); ++n) {
+            Line const line = m_game.m_lines[n];
+            for (int i=0; i < base; ++i) {
+                int const cell = line.cell(i);
+                if (cell < 0 || cell >= m_game.m_cells) {
+                    return fail("line " + std::to_string(n) + " leaves the board");
+                }
+                through[cell]++;
+                if (i == 0) {
+                    continue;
+                }
+                // every coordinate moves by the same -1, 0 or +1 each cell
+                int const prev = line.cell(i - 1);
+                for (int a=cell, b=prev, d=0; d < m_game.m_dims; ++d, a /= grid, b /= grid) {
+                    int const step = a % grid - b % grid;
+                    int const first = (line.cell(1) / InARowGame::cells(grid, d)) % grid - (line.cell(0) / InARowGame::cells(grid, d)) % grid;
+                    if (step < -1 || step > 1 || step != first) {
+                        return fail("line " + std::to_string(n) + " " + line.to_string() + " isn't straight");
+                    }
+                }
+            }
+        }
+
+        for (int c=0; c < m_game.m_cells; ++c) {
+            int entries = 0;
+            for (pair<int, int> const &entry : m_game.cell_lines(c)) {
+                entries++;
+                if (m_game.m_lines[entry.first].cell(entry.second) != c) {
+                    return fail("cell " + std::to_string(c) + " lists a Line that doesn't pass through it");
+                }
+            }
+            if (entries != through[c]) {
+                return fail("cell " + std::to_string(c) + " lists " + std::to_string(entries) + " Lines, " + std::to_string(through[c]) + " pass through it");
+            }
+        }
+
+        return true;
+    } // Verifier::check_geometry()
+
+
+    /// @name check()
+    /// @brief compare every evaluator with the reference on the current position
+    /// @returns false if one of them diverged (see error())
+    bool check() {
+        m_positions++;
+        return check_lines() && check_state() && check_boards() && check_score();
+    } // Verifier::check()
+
+
+    /// @name random_games(int const games)
+    /// @brief play random games, checking each position on the way in and on the way back out
+    bool random_games(int const games) {
+        vector<int> open;
+        vector<vector<int>> active;     // the live Lines before each move, which unmake_move() must restore in order
+
+        for (int g=0; g < games; ++g) {
+            m_game.init_board();
+            if (!check()) {
+                return false;
+            }
+
+            // stop some games early so unfinished positions are taken back too
+            int const stop = 1 + int(ThreadRng.below(uint32_t(m_game.m_cells)));
+            while (!over() && int(m_game.m_history.size()) < stop) {
+                open.clear();
+                for (int c=0; c < m_game.m_cells; ++c) {
+                    if (playable(c)) {
+                        open.push_back(c);
+                    }
+                }
+                active.push_back(m_game.m_active);
+                play(open[ThreadRng.below(uint32_t(open.size()))]);
+                if (!check()) {
+                    return false;
+                }
+            }
+
+            while (!m_game.m_history.empty()) {
+                m_game.unmake_move();
+                if (m_game.m_active != active.back()) {
+                    return fail("taking back a move didn't restore the order of the live Lines");
+                }
+                active.pop_back();
+                if (!check()) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    } // Verifier::random_games(int const games)
+
+
+    /// @name enumerate(uint64_t const limit)
+    /// @brief check every game from the empty board, depth first, until
+    /// 'limit' positions have been checked in all
+    bool enumerate(uint64_t const limit) {
+        m_game.init_board();
+        return walk(limit);
+    } // Verifier::enumerate(uint64_t const limit)
+
+};  // class Verifier
+
+#endif /* verify_h */